@@ -0,0 +1,614 @@
+#include "../src/format/gzip/checksum.h"
+#include "../src/format/gzip/decompressor.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Inflate micro-benchmarks: Decompressor::Feed over a generated corpus shaped
+ * like the npm registry (plus any tarballs named on the command line), dynamic
+ * block table builds, and raw BitReader throughput.
+ *
+ *   npmci_bench [--reps N] [tarball.tgz ...]
+ */
+namespace bench {
+  using Bytes = std::vector<unsigned char>;
+
+  volatile unsigned int sink;
+
+  /** Deterministic generator, so every run measures the same corpus */
+  class Random {
+  public:
+    explicit Random(unsigned long long seed)
+        : _state(seed * 0x9e3779b97f4a7c15ULL + 1) {}
+
+    auto Next() -> unsigned int {
+      this->_state = this->_state * 6364136223846793005ULL + 1442695040888963407ULL;
+      return (unsigned int) (this->_state >> 33);
+    }
+
+    auto Below(unsigned int n) -> unsigned int {
+      return this->Next() % n;
+    }
+
+  private:
+    unsigned long long _state;
+  };
+
+  /*-- deflate writer for the corpus --*/
+
+  class BitWriter {
+  public:
+    void Put(unsigned int value, int bits) {
+      this->_buffer |= ((unsigned long long) value & ((1ULL << bits) - 1)) << this->_count;
+      this->_count += bits;
+      while (this->_count >= 8) {
+        this->bytes.push_back((unsigned char) this->_buffer);
+        this->_buffer >>= 8;
+        this->_count -= 8;
+      }
+    }
+
+    void Align() {
+      if (this->_count) this->Put(0, 8 - this->_count);
+    }
+
+    Bytes bytes;
+
+  private:
+    unsigned long long _buffer = 0;
+    int _count                 = 0;
+  };
+
+  enum class BlockType { Stored, Fixed, Dynamic, Best };
+
+  /** literal when distance is 0 */
+  struct Token {
+    unsigned short length;
+    unsigned short distance;
+  };
+
+  /** Huffman code lengths no longer than limit, halving the frequencies until they fit */
+  auto codeLengths(std::vector<unsigned int> freqs, int limit) -> std::vector<int> {
+    using Node = std::pair<unsigned long long, int>;
+    while (true) {
+      std::vector<int> lengths(freqs.size(), 0);
+      std::vector<int> parent;
+      std::vector<int> leaves;
+      std::priority_queue<Node, std::vector<Node>, std::greater<Node>> heap;
+      for (size_t symbol = 0; symbol < freqs.size(); symbol++) {
+        if (!freqs[symbol]) continue;
+        heap.push({freqs[symbol], (int) parent.size()});
+        parent.push_back(-1);
+        leaves.push_back((int) symbol);
+      }
+      if (leaves.size() == 1) lengths[leaves[0]] = 1;
+      if (leaves.size() < 2) return lengths;
+
+      while (heap.size() > 1) {
+        Node a = heap.top();
+        heap.pop();
+        Node b = heap.top();
+        heap.pop();
+        parent[a.second] = parent[b.second] = (int) parent.size();
+        heap.push({a.first + b.first, (int) parent.size()});
+        parent.push_back(-1);
+      }
+
+      int longest = 0;
+      for (size_t leaf = 0; leaf < leaves.size(); leaf++) {
+        int depth = 0;
+        for (int node = (int) leaf; parent[node] >= 0; node = parent[node]) depth++;
+        lengths[leaves[leaf]] = depth;
+        longest               = std::max(longest, depth);
+      }
+      if (longest <= limit) return lengths;
+
+      for (auto& freq : freqs) {
+        if (freq) freq = (freq + 1) / 2;
+      }
+    }
+  }
+
+  /** canonical codes, bit-reversed for LSB-first output */
+  auto canonicalCodes(const std::vector<int>& lengths) -> std::vector<unsigned int> {
+    unsigned int count[16] = {};
+    unsigned int next[16]  = {};
+    for (int length : lengths) count[length]++;
+    count[0] = 0;
+    for (int length = 1; length < 16; length++) next[length] = (next[length - 1] + count[length - 1]) << 1;
+
+    std::vector<unsigned int> codes(lengths.size(), 0);
+    for (size_t symbol = 0; symbol < lengths.size(); symbol++) {
+      int length = lengths[symbol];
+      if (!length) continue;
+      unsigned int code = next[length]++;
+      for (int i = 0; i < length; i++) codes[symbol] |= ((code >> i) & 1) << (length - 1 - i);
+    }
+    return codes;
+  }
+
+  auto lengthCode(unsigned int length) -> int {
+    int code = kMatchLenSyms - 1;
+    while ((kMatchLenCode[code] & 0x7fff) > length) code--;
+    return code;
+  }
+
+  auto offsetCode(unsigned int distance) -> int {
+    int code = 29;
+    while ((kOffsetCode[code] & 0x7fff) > distance) code--;
+    return code;
+  }
+
+  /** Greedy LZ77 with hash chains, in the spirit of gzip -6 */
+  auto matchTokens(const Bytes& data) -> std::vector<Token> {
+    constexpr size_t kWindow = 32768;
+    std::vector<int> head(1 << 15, -1);
+    std::vector<int> prev(kWindow, -1);
+    std::vector<Token> tokens;
+
+    auto insert = [&](size_t i) {
+      if (i + 3 > data.size()) return;
+      unsigned int hash   = ((data[i] << 10) ^ (data[i + 1] << 5) ^ data[i + 2]) & 0x7fff;
+      prev[i % kWindow] = head[hash];
+      head[hash]          = (int) i;
+    };
+
+    for (size_t i = 0; i < data.size();) {
+      size_t best = 0, best_distance = 0;
+      if (i + 3 <= data.size()) {
+        unsigned int hash = ((data[i] << 10) ^ (data[i + 1] << 5) ^ data[i + 2]) & 0x7fff;
+        size_t longest    = std::min((size_t) 258, data.size() - i);
+        int candidate     = head[hash];
+        for (int chain = 0; chain < 32 && candidate >= 0 && i - candidate <= kWindow; chain++) {
+          size_t length = 0;
+          while (length < longest && data[candidate + length] == data[i + length]) length++;
+          if (length > best) {
+            best          = length;
+            best_distance = i - candidate;
+            if (length == longest) break;
+          }
+          candidate = prev[candidate % kWindow];
+        }
+      }
+
+      if (best >= 3) {
+        tokens.push_back({(unsigned short) best, (unsigned short) best_distance});
+        for (size_t k = 0; k < best; k++) insert(i + k);
+        i += best;
+      } else {
+        tokens.push_back({data[i], 0});
+        insert(i);
+        i++;
+      }
+    }
+    return tokens;
+  }
+
+  /** deflate block of tokens covering data[from, to), as stored, fixed or dynamic, or whichever is smallest */
+  void writeBlock(BitWriter& writer, const Bytes& data, size_t from, size_t to, const Token* tokens, size_t count, bool last, BlockType type) {
+    std::vector<unsigned int> literal_freqs(286, 0), offset_freqs(30, 0);
+    literal_freqs[kEODMarkerSym] = 1;
+    size_t extra_bits            = 0;
+    for (size_t i = 0; i < count; i++) {
+      if (!tokens[i].distance) {
+        literal_freqs[tokens[i].length]++;
+        continue;
+      }
+      int length_code = lengthCode(tokens[i].length);
+      int offset_code = offsetCode(tokens[i].distance);
+      literal_freqs[kMatchLenSymStart + length_code]++;
+      offset_freqs[offset_code]++;
+      extra_bits += ((kMatchLenCode[length_code] >> 16) & 15) + ((kOffsetCode[offset_code] >> 16) & 15);
+    }
+
+    std::vector<int> fixed_literals(288, 8), fixed_offsets(30, 5);
+    std::fill(fixed_literals.begin() + 144, fixed_literals.begin() + 256, 9);
+    std::fill(fixed_literals.begin() + 256, fixed_literals.begin() + 280, 7);
+
+    // an offset code of one symbol only works for some decoders, always give it two
+    offset_freqs[0] = std::max(offset_freqs[0], 1U);
+    offset_freqs[1] = std::max(offset_freqs[1], 1U);
+    auto literal_lengths = codeLengths(literal_freqs, 15);
+    auto offset_lengths  = codeLengths(offset_freqs, 15);
+
+    int literal_syms = 286, offset_syms = 30;
+    while (!literal_lengths[literal_syms - 1]) literal_syms--;
+    while (offset_syms > 1 && !offset_lengths[offset_syms - 1]) offset_syms--;
+
+    // code lengths, run-length coded with 16 (repeat previous), 17 and 18 (zeros)
+    std::vector<int> all(literal_lengths.begin(), literal_lengths.begin() + literal_syms);
+    all.insert(all.end(), offset_lengths.begin(), offset_lengths.begin() + offset_syms);
+    std::vector<std::pair<int, int>> runs;
+    for (size_t i = 0; i < all.size();) {
+      size_t run = 1;
+      while (i + run < all.size() && all[i + run] == all[i]) run++;
+      if (all[i] == 0 && run >= 3) {
+        run = std::min(run, (size_t) 138);
+        runs.push_back(run >= 11 ? std::make_pair(18, (int) run - 11) : std::make_pair(17, (int) run - 3));
+      } else if (i > 0 && all[i] == all[i - 1] && run >= 3) {
+        run = std::min(run, (size_t) 6);
+        runs.push_back({16, (int) run - 3});
+      } else {
+        run = 1;
+        runs.push_back({all[i], 0});
+      }
+      i += run;
+    }
+
+    std::vector<unsigned int> code_len_freqs(kCodeLenSyms, 0);
+    for (auto& run : runs) code_len_freqs[run.first]++;
+    auto code_len_lengths = codeLengths(code_len_freqs, 7);
+    static const int code_len_order[kCodeLenSyms] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+    int code_len_syms                             = kCodeLenSyms;
+    while (code_len_syms > 4 && !code_len_lengths[code_len_order[code_len_syms - 1]]) code_len_syms--;
+
+    size_t fixed_bits = 3 + extra_bits, dynamic_bits = 3 + 14 + 3 * code_len_syms + extra_bits;
+    for (size_t symbol = 0; symbol < literal_freqs.size(); symbol++) {
+      fixed_bits += literal_freqs[symbol] * fixed_literals[symbol];
+      dynamic_bits += literal_freqs[symbol] * literal_lengths[symbol];
+    }
+    for (size_t symbol = 0; symbol < offset_freqs.size(); symbol++) {
+      fixed_bits += offset_freqs[symbol] * 5;
+      dynamic_bits += offset_freqs[symbol] * offset_lengths[symbol];
+    }
+    for (auto& run : runs) dynamic_bits += code_len_lengths[run.first] + (run.first == 16 ? 2 : run.first == 17 ? 3 : run.first == 18 ? 7 : 0);
+    size_t stored_bits = 8 * ((to - from) + 5 * ((to - from) / 65535 + 1)) + 7;
+
+    if (type == BlockType::Best) {
+      type = stored_bits < std::min(fixed_bits, dynamic_bits) ? BlockType::Stored
+             : fixed_bits <= dynamic_bits                      ? BlockType::Fixed
+                                                               : BlockType::Dynamic;
+    }
+
+    if (type == BlockType::Stored) {
+      size_t at = from;
+      do {
+        size_t length = std::min(to - at, (size_t) 65535);
+        writer.Put(last && at + length == to, 1);
+        writer.Put(0, 2);
+        writer.Align();
+        writer.Put((unsigned int) length, 16);
+        writer.Put((unsigned int) ~length & 0xffff, 16);
+        writer.bytes.insert(writer.bytes.end(), data.begin() + at, data.begin() + at + length);
+        at += length;
+      } while (at < to);
+      return;
+    }
+
+    if (type == BlockType::Fixed) {
+      literal_lengths = fixed_literals;
+      offset_lengths  = fixed_offsets;
+    }
+    auto literal_codes = canonicalCodes(literal_lengths);
+    auto offset_codes  = canonicalCodes(offset_lengths);
+
+    writer.Put(last, 1);
+    if (type == BlockType::Fixed) {
+      writer.Put(1, 2);
+    } else {
+      writer.Put(2, 2);
+      writer.Put(literal_syms - 257, 5);
+      writer.Put(offset_syms - 1, 5);
+      writer.Put(code_len_syms - 4, 4);
+      for (int i = 0; i < code_len_syms; i++) writer.Put(code_len_lengths[code_len_order[i]], 3);
+      auto code_len_codes = canonicalCodes(code_len_lengths);
+      for (auto& run : runs) {
+        writer.Put(code_len_codes[run.first], code_len_lengths[run.first]);
+        if (run.first >= 16) writer.Put(run.second, run.first == 16 ? 2 : run.first == 17 ? 3 : 7);
+      }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+      const Token& token = tokens[i];
+      if (!token.distance) {
+        writer.Put(literal_codes[token.length], literal_lengths[token.length]);
+        continue;
+      }
+      int length_code = lengthCode(token.length);
+      int offset_code = offsetCode(token.distance);
+      writer.Put(literal_codes[kMatchLenSymStart + length_code], literal_lengths[kMatchLenSymStart + length_code]);
+      writer.Put(token.length - (kMatchLenCode[length_code] & 0x7fff), (kMatchLenCode[length_code] >> 16) & 15);
+      writer.Put(offset_codes[offset_code], offset_lengths[offset_code]);
+      writer.Put(token.distance - (kOffsetCode[offset_code] & 0x7fff), (kOffsetCode[offset_code] >> 16) & 15);
+    }
+    writer.Put(literal_codes[kEODMarkerSym], literal_lengths[kEODMarkerSym]);
+  }
+
+  /** gzip member of data, in blocks of at most 16K tokens like zlib */
+  auto gzip(const Bytes& data, BlockType type) -> Bytes {
+    constexpr size_t kBlockTokens = 16383;
+    BitWriter writer;
+    writer.bytes = {0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03};
+
+    auto tokens = matchTokens(data);
+    size_t from = 0;
+    for (size_t first = 0; first < tokens.size() || first == 0; first += kBlockTokens) {
+      size_t count = std::min(kBlockTokens, tokens.size() - first);
+      size_t to    = from;
+      for (size_t i = first; i < first + count; i++) to += tokens[i].distance ? tokens[i].length : 1;
+      writeBlock(writer, data, from, to, tokens.data() + first, count, first + count >= tokens.size(), type);
+      from = to;
+    }
+    writer.Align();
+
+    unsigned int crc = Crc32(0, data.data(), data.size());
+    writer.Put(crc, 32);
+    writer.Put((unsigned int) data.size(), 32);
+    return writer.bytes;
+  }
+
+  /*-- package contents --*/
+
+  auto identifier(Random& rng) -> std::string {
+    static const char* syllables[] = {"get", "set", "on", "to", "re", "de", "co", "pre", "val", "opt", "ion", "ent", "er", "ize", "ed", "map", "key", "node", "path", "str"};
+    std::string name;
+    for (unsigned int i = 0, n = 2 + rng.Below(3); i < n; i++) name += syllables[rng.Below(20)];
+    if (rng.Below(3) == 0) name[0] = (char) (name[0] - 'a' + 'A');
+    return name;
+  }
+
+  /** CommonJS-looking source with its own identifiers, so files compress like real ones */
+  auto javascript(Random& rng, size_t size, bool minified) -> Bytes {
+    std::vector<std::string> names;
+    for (int i = 0; i < 40; i++) names.push_back(identifier(rng));
+    auto name    = [&]() -> const std::string& { return names[rng.Below((unsigned int) names.size())]; };
+    const char* nl  = minified ? "" : "\n";
+    const char* tab = minified ? "" : "  ";
+
+    std::string text = "'use strict';" + std::string(nl);
+    while (text.size() < size) {
+      switch (rng.Below(7)) {
+        case 0: text += "const " + name() + " = require('" + name() + "');" + nl; break;
+        case 1: text += "function " + name() + "(" + name() + ", " + name() + ") {" + nl + tab + "return " + name() + "." + name() + "(" + name() + ");" + nl + "}" + nl; break;
+        case 2: text += std::string(tab) + "if (" + name() + " === undefined) { throw new TypeError('" + name() + " is required'); }" + nl; break;
+        case 3: text += std::string(tab) + name() + "." + name() + " = " + std::to_string(rng.Below(100000)) + ";" + nl; break;
+        case 4: if (!minified) text += "// " + name() + " " + name() + " " + name() + "\n"; break;
+        case 5: text += std::string(tab) + "for (let i = 0; i < " + name() + ".length; i++) " + name() + "[i] = " + name() + "(i);" + nl; break;
+        default: text += "module.exports." + name() + " = " + name() + ";" + nl; break;
+      }
+    }
+    text.resize(size);
+    return Bytes(text.begin(), text.end());
+  }
+
+  auto binary(Random& rng, size_t size) -> Bytes {
+    Bytes data(size);
+    for (auto& byte : data) byte = (unsigned char) rng.Next();
+    return data;
+  }
+
+  void addTarFile(Bytes& tar, const std::string& name, const Bytes& content) {
+    unsigned char header[512] = {};
+    std::memcpy(header, name.c_str(), std::min(name.size(), (size_t) 99));
+    std::snprintf((char*) header + 100, 8, "%07o", 0644);
+    std::snprintf((char*) header + 108, 8, "%07o", 0);
+    std::snprintf((char*) header + 116, 8, "%07o", 0);
+    std::snprintf((char*) header + 124, 12, "%011o", (unsigned int) content.size());
+    std::snprintf((char*) header + 136, 12, "%011o", 499162500U);
+    header[156] = '0';
+    std::memcpy(header + 257, "ustar", 6);
+    std::memcpy(header + 263, "00", 2);
+    std::memset(header + 148, ' ', 8);
+    unsigned int checksum = 0;
+    for (unsigned char byte : header) checksum += byte;
+    std::snprintf((char*) header + 148, 8, "%06o", checksum);
+
+    tar.insert(tar.end(), header, header + 512);
+    tar.insert(tar.end(), content.begin(), content.end());
+    tar.resize((tar.size() + 511) / 512 * 512, 0);
+  }
+
+  /** npm-style tarball: package.json plus sources of about file_size bytes */
+  auto package(Random& rng, size_t files, size_t file_size, size_t asset_size = 0) -> Bytes {
+    std::string manifest = "{\n  \"name\": \"" + identifier(rng) + "\",\n  \"version\": \"1." + std::to_string(rng.Below(20)) + ".0\",\n  \"main\": \"index.js\",\n  \"license\": \"MIT\"\n}\n";
+    Bytes tar;
+    addTarFile(tar, "package/package.json", Bytes(manifest.begin(), manifest.end()));
+    for (size_t i = 0; i < files; i++) {
+      size_t size = file_size / 2 + rng.Below((unsigned int) file_size + 1);
+      addTarFile(tar, "package/lib/" + identifier(rng) + ".js", javascript(rng, size, rng.Below(4) == 0));
+    }
+    if (asset_size) addTarFile(tar, "package/assets/font.woff2", binary(rng, asset_size));
+    tar.resize(tar.size() + 1024, 0);
+    return tar;
+  }
+
+  /*-- measurement --*/
+
+  struct Stream {
+    Bytes compressed;
+    unsigned int size;
+  };
+
+  struct Group {
+    std::string name;
+    std::vector<Stream> streams;
+    size_t bytes = 0;
+
+    void Add(Bytes compressed) {
+      unsigned int size = Decompressor::InflatedSize(compressed.data(), (unsigned int) compressed.size());
+      this->bytes += size;
+      this->streams.push_back({std::move(compressed), size});
+    }
+  };
+
+  auto generateCorpus() -> std::vector<Group> {
+    Random rng(2024);
+    std::vector<Group> corpus(5);
+
+    corpus[0].name = "tiny, 400 x ~3 KB";
+    for (int i = 0; i < 400; i++) corpus[0].Add(gzip(package(rng, 1 + rng.Below(2), 200 + rng.Below(1500)), BlockType::Best));
+
+    corpus[1].name = "fixed blocks, 100 x 16 KB";
+    for (int i = 0; i < 100; i++) corpus[1].Add(gzip(package(rng, 4, 4096), BlockType::Fixed));
+
+    corpus[2].name = "dynamic, 20 x 600 KB";
+    for (int i = 0; i < 20; i++) corpus[2].Add(gzip(package(rng, 60, 10000), BlockType::Best));
+
+    corpus[3].name = "huge, 2 x 24 MB";
+    for (int i = 0; i < 2; i++) corpus[3].Add(gzip(package(rng, 800, 30000), BlockType::Best));
+
+    corpus[4].name = "stored, 4 MB binary asset";
+    corpus[4].Add(gzip(package(rng, 2, 2000, 4 << 20), BlockType::Best));
+    return corpus;
+  }
+
+  /** seconds taken by each of reps runs, after one warm-up run */
+  template<class Run>
+  auto measure(int reps, const Run& run) -> std::vector<double> {
+    std::vector<double> seconds;
+    run();
+    for (int i = 0; i < reps; i++) {
+      auto start = std::chrono::steady_clock::now();
+      run();
+      seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return seconds;
+  }
+
+  /** print the rate of amount units per second over the runs: mean, relative standard deviation, min and max */
+  void report(const std::string& name, double amount, const char* unit, const std::vector<double>& seconds) {
+    std::vector<double> rates;
+    for (double s : seconds) rates.push_back(amount / s);
+    double mean = 0, variance = 0;
+    for (double rate : rates) mean += rate / rates.size();
+    for (double rate : rates) variance += (rate - mean) * (rate - mean) / std::max((size_t) 1, rates.size() - 1);
+    auto range = std::minmax_element(rates.begin(), rates.end());
+    std::printf("%-40s %9.1f %-9s ±%5.1f%%   min %9.1f   max %9.1f\n", name.c_str(), mean, unit, 100 * std::sqrt(variance) / mean, *range.first, *range.second);
+  }
+
+  void benchFeed(const Group& group, int reps) {
+    std::vector<Bytes> out;
+    for (const auto& stream : group.streams) out.emplace_back(stream.size);
+
+    for (size_t i = 0; i < group.streams.size(); i++) {
+      const auto& stream = group.streams[i];
+      if (Decompressor::Feed(stream.compressed.data(), (unsigned int) stream.compressed.size(), out[i].data(), stream.size, true) != stream.size) {
+        std::fprintf(stderr, "%s: stream %zu does not inflate\n", group.name.c_str(), i);
+        std::exit(1);
+      }
+    }
+
+    auto seconds = measure(reps, [&]() {
+      for (size_t i = 0; i < group.streams.size(); i++) {
+        const auto& stream = group.streams[i];
+        sink = sink + Decompressor::Feed(stream.compressed.data(), (unsigned int) stream.compressed.size(), out[i].data(), stream.size, true);
+      }
+    });
+    report("Feed  " + group.name, group.bytes / 1e6, "MB/s", seconds);
+
+    unsigned int threads = std::thread::hardware_concurrency();
+    if (threads > 1 && group.bytes >= (64U << 20)) {
+      seconds = measure(reps, [&]() {
+        for (size_t i = 0; i < group.streams.size(); i++) {
+          const auto& stream = group.streams[i];
+          sink = sink + Decompressor::FeedParallel(stream.compressed.data(), (unsigned int) stream.compressed.size(), out[i].data(), stream.size, true, threads);
+        }
+      });
+      report("FeedParallel x" + std::to_string(threads) + "  " + group.name, group.bytes / 1e6, "MB/s", seconds);
+    }
+  }
+
+  /** tables of the first block of a stream, rebuilt from its header over and over */
+  void benchTables(const Group& group, int reps) {
+    const Bytes& compressed = group.streams.front().compressed;
+    auto* stream            = const_cast<unsigned char*>(compressed.data()) + 10;
+    auto* end               = const_cast<unsigned char*>(compressed.data()) + compressed.size();
+    std::unique_ptr<BlockTables> scratch(new BlockTables);
+    constexpr int kBuilds = 2000;
+
+    BitReader probe;
+    probe.Init(stream, end);
+    if (probe.GetBits(3) >> 1 != 2) {
+      std::fprintf(stderr, "%s: first block is not dynamic\n", group.name.c_str());
+      return;
+    }
+
+    auto seconds = measure(reps, [&]() {
+      for (int i = 0; i < kBuilds; i++) {
+        BitReader bit_reader;
+        bit_reader.Init(stream, end);
+        bit_reader.GetBits(3);
+        sink = sink + (PrepareBlock(&bit_reader, 1, scratch.get()) != nullptr);
+      }
+    });
+    report("HuffmanDecoder dynamic block tables", kBuilds / 1e3, "k/s", seconds);
+  }
+
+  void benchBitReader(int reps) {
+    Random rng(7);
+    Bytes data = binary(rng, 16 << 20);
+    size_t bits = (data.size() - 16) * 8;
+
+    auto seconds = measure(reps, [&]() {
+      BitReader bit_reader;
+      bit_reader.Init(data.data(), data.data() + data.size());
+      unsigned int sum = 0;
+      for (size_t consumed = 0, width = 1; consumed + 16 <= bits; consumed += width, width = width % 15 + 1) sum += bit_reader.GetBits((int) width);
+      sink = sum;
+    });
+    report("BitReader GetBits, 1..15 bits", data.size() / 1e6, "MB/s", seconds);
+
+    seconds = measure(reps, [&]() {
+      BitReader bit_reader;
+      bit_reader.Init(data.data(), data.data() + data.size());
+      unsigned int sum = 0;
+      for (size_t consumed = 0, width = 1; consumed + 16 <= bits; consumed += width, width = width % 15 + 1) {
+        bit_reader.Refill();
+        sum += bit_reader.PeekRefilled() & ((1U << width) - 1);
+        bit_reader.ConsumeBits((int) width);
+      }
+      sink = sum;
+    });
+    report("BitReader Refill/PeekRefilled, 1..15 bits", data.size() / 1e6, "MB/s", seconds);
+  }
+
+  auto readFile(const std::string& path) -> Bytes {
+    std::ifstream file(path, std::ios::binary);
+    return Bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  }
+}  // namespace bench
+
+auto main(int argc, char** argv) -> int {
+  int reps = 10;
+  std::vector<std::string> files;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--reps" && i + 1 < argc) {
+      reps = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--help" || arg == "-h") {
+      std::printf("usage: %s [--reps N] [tarball.tgz ...]\n", argv[0]);
+      return 0;
+    } else {
+      files.push_back(arg);
+    }
+  }
+
+  auto corpus = bench::generateCorpus();
+  for (const auto& path : files) {
+    bench::Bytes compressed = bench::readFile(path);
+    if (Decompressor::InflatedSize(compressed.data(), (unsigned int) compressed.size()) == -1) {
+      std::fprintf(stderr, "%s: not a gzip file\n", path.c_str());
+      return 1;
+    }
+    corpus.emplace_back();
+    corpus.back().name = path.substr(path.find_last_of("/\\") + 1);
+    corpus.back().Add(std::move(compressed));
+  }
+
+  std::printf("%d runs each, rate over all streams of a group\n\n", reps);
+  for (const auto& group : corpus) bench::benchFeed(group, reps);
+  bench::benchTables(corpus[2], reps);
+  bench::benchBitReader(reps);
+  return 0;
+}
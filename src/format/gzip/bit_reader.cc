@@ -20,36 +20,24 @@ void BitReader::Init(unsigned char* in_block, unsigned char* in_block_end) {
   this->in_block_start_ = in_block;
 }
 
-/** Refill 32 bits at a time if the architecture allows it, otherwise do nothing. */
-void BitReader::Refill32() {
-#ifdef X64BIT_SHIFTER
-  if (this->shifter_bit_count_ <= 32 && (this->in_block_ + 4) <= this->in_block_end_) {
-#  ifdef defined(_M_X64) || defined(__x86_64__)
-    this->shifter_data_ |= (((shifter_t)(*((unsigned int*) this->in_block_))) << this->shifter_bit_count_);
-    this->shifter_bit_count_ += 32;
-    this->in_block_ += 4;
-#  else
-    this->shifter_data_ |= (((shifter_t)(*this->in_block_++)) << this->shifter_bit_count_);
-    this->shifter_bit_count_ += 8;
-    this->shifter_data_ |= (((shifter_t)(*this->in_block_++)) << this->shifter_bit_count_);
-    this->shifter_bit_count_ += 8;
-    this->shifter_data_ |= (((shifter_t)(*this->in_block_++)) << this->shifter_bit_count_);
-    this->shifter_bit_count_ += 8;
-    this->shifter_data_ |= (((shifter_t)(*this->in_block_++)) << this->shifter_bit_count_);
-    this->shifter_bit_count_ += 8;
-#  endif
-  }
-#endif /* X64BIT_SHIFTER */
-}
-
 /**
- * Consume variable bit-length value, after reading it with PeekBits()
+ * Continue reading from another buffer, keeping the bits already shifted in
  *
- * @param n size of value to consume, in bits
+ * @param in_block pointer to the next unread byte
+ * @param in_block_end pointer to the end of the buffer + 1
  */
-void BitReader::ConsumeBits(const int n) {
-  this->shifter_data_ >>= n;
-  this->shifter_bit_count_ -= n;
+void BitReader::Rebase(unsigned char* in_block, unsigned char* in_block_end) {
+  this->in_block_       = in_block;
+  this->in_block_end_   = in_block_end;
+  this->in_block_start_ = in_block;
+}
+
+/** Refill byte by byte, near the end of the input or where the shifter is 32 bits wide */
+void BitReader::RefillSlow() {
+  while (this->shifter_bit_count_ < (int) sizeof(shifter_t) * 8 - 8 && this->in_block_ < this->in_block_end_) {
+    this->shifter_data_ |= ((shifter_t) (*this->in_block_++)) << this->shifter_bit_count_;
+    this->shifter_bit_count_ += 8;
+  }
 }
 
 /**
@@ -61,17 +49,9 @@ void BitReader::ConsumeBits(const int n) {
  */
 unsigned int BitReader::GetBits(const int n) {
   if (this->shifter_bit_count_ < n) {
-    if (this->in_block_ < this->in_block_end_) {
-      this->shifter_data_ |= (((shifter_t)(*this->in_block_++)) << this->shifter_bit_count_);
-      this->shifter_bit_count_ += 8;
-
-      if (this->in_block_ < this->in_block_end_) {
-        this->shifter_data_ |= (((shifter_t)(*this->in_block_++)) << this->shifter_bit_count_);
-        this->shifter_bit_count_ += 8;
-      }
-    } else {
+    this->Refill();
+    if (this->shifter_bit_count_ < n)
       return -1;
-    }
   }
 
   unsigned int value = this->shifter_data_ & ((1 << n) - 1);
@@ -86,14 +66,8 @@ unsigned int BitReader::GetBits(const int n) {
  * @return value
  */
 unsigned int BitReader::PeekBits() {
-  if (this->shifter_bit_count_ < 16) {
-    if (this->in_block_ < this->in_block_end_) {
-      this->shifter_data_ |= (((shifter_t)(*this->in_block_++)) << this->shifter_bit_count_);
-      if (this->in_block_ < this->in_block_end_)
-        this->shifter_data_ |= (((shifter_t)(*this->in_block_++)) << (this->shifter_bit_count_ + 8));
-      this->shifter_bit_count_ += 16;
-    }
-  }
+  if (this->shifter_bit_count_ < 16)
+    this->Refill();
 
   return this->shifter_data_ & 0xffff;
 }
@@ -111,6 +85,18 @@ int BitReader::ByteAllign() {
   return 0;
 }
 
+/** Drop the bits up to the next byte boundary, whole bytes stay in the shifter */
+void BitReader::SkipToByte() {
+  this->ConsumeBits(this->shifter_bit_count_ & 7);
+}
+
+/**
+ * Skip bytes read directly from the input. Lookahead bits loaded past the
+ * count belong to those bytes, so they are dropped.
+ *
+ * @param v number of bytes
+ */
 void BitReader::ModifyInBlock(const int v) {
+  this->shifter_data_ &= ~(~(shifter_t) 0 << this->shifter_bit_count_);
   this->in_block_ += v;
 }
@@ -1,6 +1,8 @@
 #ifndef _BIT_READER_H
 #define _BIT_READER_H
 
+#include <cstring>
+
 #if defined(_M_X64) || defined(__x86_64__) || defined(__aarch64__)
 #  define X64BIT_SHIFTER
 #endif /* defined(_M_X64) */
@@ -11,20 +13,76 @@ typedef unsigned long long shifter_t;
 typedef unsigned int shifter_t;
 #endif /* X64BIT_SHIFTER */
 
+/* Readable bytes RefillFast() needs at GetInBlock() */
+constexpr auto kRefillBytes = 8;
+
 class BitReader {
 public:
   BitReader();
   ~BitReader() = default;
 
   void Init(unsigned char*, unsigned char*);
-  void ConsumeBits(const int);
+  void Rebase(unsigned char*, unsigned char*);
   void ModifyInBlock(const int);
-  void Refill32();
+  void RefillSlow();
+
+#ifdef X64BIT_SHIFTER
+  /**
+   * Top the shifter up to 56 bits or more with one unaligned load and no
+   * branches. Padded-input contract: kRefillBytes must be readable at
+   * GetInBlock(); bits loaded past the count are the next bits of the
+   * stream, so loading them again later is harmless.
+   */
+  void RefillFast() {
+    unsigned long long word;
+    std::memcpy(&word, this->in_block_, sizeof(word));
+#  if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    word = __builtin_bswap64(word);
+#  endif
+    this->shifter_data_ |= word << this->shifter_bit_count_;
+    this->in_block_ += (63 - this->shifter_bit_count_) >> 3;
+    this->shifter_bit_count_ |= 56;
+  };
+#endif /* X64BIT_SHIFTER */
+
+  /** Top the shifter up to 56 bits or more, or as many as the input has left */
+  void Refill() {
+#ifdef X64BIT_SHIFTER
+    if (this->in_block_end_ - this->in_block_ >= kRefillBytes) {
+      this->RefillFast();
+      return;
+    }
+#endif /* X64BIT_SHIFTER */
+    this->RefillSlow();
+  };
 
   unsigned int GetBits(const int);
   unsigned int PeekBits();
 
   int ByteAllign();
+  void SkipToByte();
+
+  /**
+   * Consume variable bit-length value, after reading it with PeekBits() or PeekRefilled()
+   *
+   * @param n size of value to consume, in bits
+   */
+  void ConsumeBits(const int n) {
+    this->shifter_data_ >>= n;
+    this->shifter_bit_count_ -= n;
+  };
+
+  /** @return the bits in the shifter, for lookahead right after a refill made enough available */
+  unsigned int PeekRefilled() const {
+    return (unsigned int) this->shifter_data_;
+  };
+
+  int GetBitCount() {
+    return this->shifter_bit_count_;
+  };
+  long long GetAvailableBits() {
+    return (long long) (this->in_block_end_ - this->in_block_) * 8 + this->shifter_bit_count_;
+  };
 
   unsigned char* GetInBlock() {
     return this->in_block_;
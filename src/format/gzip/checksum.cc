@@ -0,0 +1,244 @@
+#include "checksum.h"
+
+#include "cpu_features.h"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#  define CHECKSUM_X86
+#  include <immintrin.h>
+#  ifdef _MSC_VER
+#    define TARGET_PCLMUL
+#    define TARGET_SSSE3
+#  else
+#    define TARGET_PCLMUL __attribute__((target("sse4.1,pclmul")))
+#    define TARGET_SSSE3 __attribute__((target("ssse3")))
+#  endif
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#  define CHECKSUM_ARM_CRC
+#  include <arm_acle.h>
+#endif
+
+constexpr unsigned int kAdlerBase = 65521;
+constexpr unsigned int kAdlerNMax = 5552; /* most bytes before s2 can overflow 32 bits */
+
+/* Slicing-by-8 tables of the reflected CRC-32 polynomial */
+constexpr auto MakeCrcTables() {
+  std::array<std::array<uint32_t, 256>, 8> tables{};
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t crc = i;
+    for (int bit = 0; bit < 8; bit++)
+      crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+    tables[0][i] = crc;
+  }
+  for (uint32_t i = 0; i < 256; i++) {
+    for (int slice = 1; slice < 8; slice++)
+      tables[slice][i] = (tables[slice - 1][i] >> 8) ^ tables[0][tables[slice - 1][i] & 0xff];
+  }
+  return tables;
+}
+
+constexpr auto kCrcTables = MakeCrcTables();
+
+static uint32_t Crc32Scalar(uint32_t crc, const unsigned char* data, size_t size) {
+  for (; size >= 8; data += 8, size -= 8) {
+    uint32_t low, high;
+    std::memcpy(&low, data, 4);
+    std::memcpy(&high, data + 4, 4);
+    low ^= crc;
+    crc = kCrcTables[7][low & 0xff] ^ kCrcTables[6][(low >> 8) & 0xff] ^ kCrcTables[5][(low >> 16) & 0xff] ^ kCrcTables[4][low >> 24] ^
+          kCrcTables[3][high & 0xff] ^ kCrcTables[2][(high >> 8) & 0xff] ^ kCrcTables[1][(high >> 16) & 0xff] ^ kCrcTables[0][high >> 24];
+  }
+  while (size--)
+    crc = (crc >> 8) ^ kCrcTables[0][(crc ^ *data++) & 0xff];
+  return crc;
+}
+
+static uint32_t Adler32Scalar(uint32_t adler, const unsigned char* data, size_t size) {
+  uint32_t s1 = adler & 0xffff;
+  uint32_t s2 = adler >> 16;
+
+  while (size) {
+    size_t n = size < kAdlerNMax ? size : kAdlerNMax;
+    size -= n;
+    while (n--) {
+      s1 += *data++;
+      s2 += s1;
+    }
+    s1 %= kAdlerBase;
+    s2 %= kAdlerBase;
+  }
+  return s1 | (s2 << 16);
+}
+
+#ifdef CHECKSUM_X86
+static const bool kCrc32Fold     = GetCpuFeatures().pclmul && GetCpuFeatures().sse41;
+static const bool kAdler32Blocks = GetCpuFeatures().ssse3;
+
+/**
+ * CRC-32 by folding 64 bytes at a time with carry-less multiplication, then
+ * Barrett reduction (Intel, "Fast CRC Computation for Generic Polynomials
+ * Using PCLMULQDQ Instruction")
+ *
+ * @param crc running CRC, not inverted
+ * @param size number of bytes, at least 64 and a multiple of 16
+ */
+TARGET_PCLMUL static uint32_t Crc32Fold(uint32_t crc, const unsigned char* data, size_t size) {
+  alignas(16) static const uint64_t k1k2[] = {0x0154442bd4, 0x01c6e41596};
+  alignas(16) static const uint64_t k3k4[] = {0x01751997d0, 0x00ccaa009e};
+  alignas(16) static const uint64_t k5k0[] = {0x0163cd6124, 0x0000000000};
+  alignas(16) static const uint64_t poly[] = {0x01db710641, 0x01f7011641};
+
+  __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+  x1 = _mm_loadu_si128((const __m128i*) (data + 0x00));
+  x2 = _mm_loadu_si128((const __m128i*) (data + 0x10));
+  x3 = _mm_loadu_si128((const __m128i*) (data + 0x20));
+  x4 = _mm_loadu_si128((const __m128i*) (data + 0x30));
+  x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int) crc));
+  x0 = _mm_load_si128((const __m128i*) k1k2);
+  data += 64;
+  size -= 64;
+
+  /* four lanes folded in parallel */
+  while (size >= 64) {
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+    x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+    x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+    x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*) (data + 0x00)));
+    x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i*) (data + 0x10)));
+    x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i*) (data + 0x20)));
+    x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i*) (data + 0x30)));
+    data += 64;
+    size -= 64;
+  }
+
+  /* fold the lanes into one */
+  x0 = _mm_load_si128((const __m128i*) k3k4);
+  for (__m128i lane : {x2, x3, x4}) {
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, lane), x5);
+  }
+
+  while (size >= 16) {
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((const __m128i*) data)), x5);
+    data += 16;
+    size -= 16;
+  }
+
+  /* 128 to 64 bits */
+  x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+  x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+  x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+  x0 = _mm_loadl_epi64((const __m128i*) k5k0);
+  x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_and_si128(x1, x3);
+  x1 = _mm_xor_si128(_mm_clmulepi64_si128(x1, x0, 0x00), x2);
+
+  /* Barrett reduction to 32 bits */
+  x0 = _mm_load_si128((const __m128i*) poly);
+  x2 = _mm_and_si128(x1, x3);
+  x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+  x2 = _mm_and_si128(x2, x3);
+  x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  return (uint32_t) _mm_extract_epi32(x1, 1);
+}
+
+/** Adler-32 of whole 32 byte blocks; byte sums with PSADBW, weighted sums with PMADDUBSW */
+TARGET_SSSE3 static uint32_t Adler32Blocks(uint32_t adler, const unsigned char* data, size_t blocks) {
+  uint32_t s1 = adler & 0xffff;
+  uint32_t s2 = adler >> 16;
+
+  const __m128i tap1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17);
+  const __m128i tap2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i ones = _mm_set1_epi16(1);
+
+  while (blocks) {
+    size_t n = blocks < kAdlerNMax / 32 ? blocks : kAdlerNMax / 32;
+    blocks -= n;
+
+    __m128i v_ps = _mm_set_epi32(0, 0, 0, (int) (s1 * n));
+    __m128i v_s2 = _mm_set_epi32(0, 0, 0, (int) s2);
+    __m128i v_s1 = _mm_setzero_si128();
+    do {
+      const __m128i bytes1 = _mm_loadu_si128((const __m128i*) data);
+      const __m128i bytes2 = _mm_loadu_si128((const __m128i*) (data + 16));
+      v_ps = _mm_add_epi32(v_ps, v_s1);
+      v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes1, zero));
+      v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_maddubs_epi16(bytes1, tap1), ones));
+      v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(bytes2, zero));
+      v_s2 = _mm_add_epi32(v_s2, _mm_madd_epi16(_mm_maddubs_epi16(bytes2, tap2), ones));
+      data += 32;
+    } while (--n);
+    v_s2 = _mm_add_epi32(v_s2, _mm_slli_epi32(v_ps, 5));
+
+    v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(2, 3, 0, 1)));
+    v_s1 = _mm_add_epi32(v_s1, _mm_shuffle_epi32(v_s1, _MM_SHUFFLE(1, 0, 3, 2)));
+    v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(2, 3, 0, 1)));
+    v_s2 = _mm_add_epi32(v_s2, _mm_shuffle_epi32(v_s2, _MM_SHUFFLE(1, 0, 3, 2)));
+    s1 = (s1 + (uint32_t) _mm_cvtsi128_si32(v_s1)) % kAdlerBase;
+    s2 = (uint32_t) _mm_cvtsi128_si32(v_s2) % kAdlerBase;
+  }
+  return s1 | (s2 << 16);
+}
+#endif /* CHECKSUM_X86 */
+
+/**
+ * Update a CRC-32 (gzip trailer) with more data
+ *
+ * @param crc CRC of the preceding data, 0 to start
+ *
+ * @return CRC including data
+ */
+unsigned int Crc32(unsigned int crc, const unsigned char* data, size_t size) {
+  uint32_t running = ~(uint32_t) crc;
+
+#if defined(CHECKSUM_X86)
+  if (kCrc32Fold && size >= 64) {
+    size_t folded = size & ~(size_t) 15;
+    running       = Crc32Fold(running, data, folded);
+    data += folded;
+    size -= folded;
+  }
+#elif defined(CHECKSUM_ARM_CRC)
+  for (; size >= 8; data += 8, size -= 8) {
+    uint64_t word;
+    std::memcpy(&word, data, 8);
+    running = __crc32d(running, word);
+  }
+#endif
+
+  return ~Crc32Scalar(running, data, size);
+}
+
+/**
+ * Update an Adler-32 (zlib trailer) with more data
+ *
+ * @param adler checksum of the preceding data, 1 to start
+ *
+ * @return checksum including data
+ */
+unsigned int Adler32(unsigned int adler, const unsigned char* data, size_t size) {
+#ifdef CHECKSUM_X86
+  if (kAdler32Blocks && size >= 32) {
+    adler = Adler32Blocks(adler, data, size / 32);
+    data += size & ~(size_t) 31;
+    size &= 31;
+  }
+#endif
+
+  return Adler32Scalar(adler, data, size);
+}
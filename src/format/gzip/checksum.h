@@ -0,0 +1,10 @@
+#ifndef _CHECKSUM_H
+#define _CHECKSUM_H
+
+#include <cstddef>
+
+/*-- gzip and zlib trailer checksums, continued across calls like zlib's crc32() and adler32() --*/
+unsigned int Crc32(unsigned int, const unsigned char*, size_t);
+unsigned int Adler32(unsigned int, const unsigned char*, size_t);
+
+#endif /* !_CHECKSUM_H */
@@ -0,0 +1,72 @@
+#include "cpu_features.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#  define CPU_FEATURES_X86
+#  ifdef _MSC_VER
+#    include <immintrin.h>
+#    include <intrin.h>
+#  else
+#    include <cpuid.h>
+#  endif
+#endif
+
+#ifdef CPU_FEATURES_X86
+/**
+ * @param leaf cpuid leaf, queried with subleaf 0
+ * @param registers eax, ebx, ecx and edx; zero when the leaf is not supported
+ */
+static void Cpuid(unsigned int leaf, unsigned int registers[4]) {
+  registers[0] = registers[1] = registers[2] = registers[3] = 0;
+#  ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 0);
+  if ((unsigned int) info[0] < leaf)
+    return;
+  __cpuidex(info, (int) leaf, 0);
+  for (int i = 0; i < 4; i++)
+    registers[i] = (unsigned int) info[i];
+#  else
+  if (__get_cpuid_max(0, nullptr) < leaf)
+    return;
+  __cpuid_count(leaf, 0, registers[0], registers[1], registers[2], registers[3]);
+#  endif
+}
+
+/** @return low word of XCR0, the register states the OS saves on context switches */
+static unsigned int Xcr0() {
+#  ifdef _MSC_VER
+  return (unsigned int) _xgetbv(0);
+#  else
+  unsigned int xcr0_low, xcr0_high;
+  __asm__("xgetbv" : "=a"(xcr0_low), "=d"(xcr0_high) : "c"(0));
+  return xcr0_low;
+#  endif
+}
+#endif /* CPU_FEATURES_X86 */
+
+static CpuFeatures DetectCpu() {
+  CpuFeatures features;
+#if defined(CPU_FEATURES_X86)
+  unsigned int leaf1[4], leaf7[4];
+  Cpuid(1, leaf1);
+  Cpuid(7, leaf7);
+
+  features.ssse3  = (leaf1[2] & (1U << 9)) != 0;
+  features.sse41  = (leaf1[2] & (1U << 19)) != 0;
+  features.sse42  = (leaf1[2] & (1U << 20)) != 0;
+  features.pclmul = (leaf1[2] & (1U << 1)) != 0;
+  features.bmi2   = (leaf7[1] & (1U << 8)) != 0;
+
+  bool os_saves_ymm = (leaf1[2] & (1U << 27)) && (Xcr0() & 6) == 6; /* OSXSAVE, then xmm and ymm state */
+  features.avx2     = os_saves_ymm && (leaf7[1] & (1U << 5));
+#elif defined(__aarch64__)
+  features.neon = true; /* part of the base architecture */
+#endif
+  return features;
+}
+
+const CpuFeatures& GetCpuFeatures() {
+  /* a function local so kernels selected during static initialization of other files see it ready */
+  static const CpuFeatures features = DetectCpu();
+  return features;
+}
@@ -0,0 +1,23 @@
+#ifndef _CPU_FEATURES_H
+#define _CPU_FEATURES_H
+
+/*-- instruction set extensions of the running CPU, beyond what the binary was compiled for --*/
+struct CpuFeatures {
+  bool ssse3  = false;
+  bool sse41  = false;
+  bool sse42  = false;
+  bool pclmul = false;
+  bool avx2   = false; /* and the OS saves the ymm registers */
+  bool bmi2   = false;
+  bool neon   = false;
+};
+
+/**
+ * Features detected on first use; the kernels of match_copy.cc, checksum.cc and
+ * decompressor.cc pick their implementation from these once, at startup
+ *
+ * @return features of the CPU this process runs on
+ */
+const CpuFeatures& GetCpuFeatures();
+
+#endif /* !_CPU_FEATURES_H */
@@ -1,5 +1,23 @@
 #include "decompressor.h"
 
+#include "checksum.h"
+#include "cpu_features.h"
+#include "match_copy.h"
+
+#if (defined(__x86_64__) || defined(_M_X64)) && !defined(_MSC_VER)
+#  define DECOMPRESSOR_BMI2
+#  define TARGET_BMI2 __attribute__((target("bmi2")))
+#endif
+
+#ifdef _MSC_VER
+#  define FORCE_INLINE __forceinline
+#else
+#  define FORCE_INLINE inline __attribute__((always_inline))
+#endif
+
+/* Output room the fast loop needs: two literal entries then a match, including the copy overrun */
+constexpr unsigned int kFastLoopOutMargin = 3 * 2 + 258 + kMatchCopyOverrun;
+
 unsigned int CopyStored(BitReader* bit_reader, unsigned char* out, unsigned int out_offset, unsigned int block_size_max) {
   if (bit_reader->ByteAllign() < 0)
     return -1;
@@ -7,7 +25,7 @@ unsigned int CopyStored(BitReader* bit_reader, unsigned char* out, unsigned int
   if ((bit_reader->GetInBlock() + 4) > bit_reader->GetInBlockEnd())
     return -1;
 
-  unsigned short stored_length = ((unsigned short) bit_reader->GetInBlock()[0]) | (((unsigned short) bit_reader->GetInBlock()[0]) << 8);
+  unsigned short stored_length = ((unsigned short) bit_reader->GetInBlock()[0]) | (((unsigned short) bit_reader->GetInBlock()[1]) << 8);
   bit_reader->ModifyInBlock(2);
 
   unsigned short neg_stored_length = ((unsigned short) bit_reader->GetInBlock()[0]) | (((unsigned short) bit_reader->GetInBlock()[1]) << 8);
@@ -17,7 +35,7 @@ unsigned int CopyStored(BitReader* bit_reader, unsigned char* out, unsigned int
     return -1;
   }
 
-  if (stored_length > block_size_max)
+  if (stored_length > block_size_max || (bit_reader->GetInBlock() + stored_length) > bit_reader->GetInBlockEnd())
     return -1;
 
   std::memcpy(out + out_offset, bit_reader->GetInBlock(), stored_length);
@@ -26,99 +44,255 @@ unsigned int CopyStored(BitReader* bit_reader, unsigned char* out, unsigned int
   return (unsigned int) stored_length;
 }
 
-unsigned int DecompressBlock(BitReader* bit_reader, int dynamic_block, unsigned char* out, unsigned int out_offset, unsigned int block_size_max) {
-  HuffmanDecoder literals_decoder;
-  HuffmanDecoder offset_decoder;
-  unsigned int literals_rev_sym_table[kLiteralSyms * 2];
-  unsigned int offset_rev_sym_table[kLiteralSyms * 2];
+/**
+ * Map symbols to their kMatchLenCode and kOffsetCode values and build the fast lookups
+ *
+ * @return 0 for success, -1 for failure
+ */
+static int FinalizeBlockTables(BlockTables* tables) {
   int i;
 
-  if (dynamic_block) {
-    HuffmanDecoder tables_decoder;
-    unsigned char code_length[kLiteralSyms + kOffsetSyms];
-    unsigned int tables_rev_sym_table[kCodeLenSyms * 2];
+  for (i = 0; i < kOffsetSyms; i++) {
+    unsigned int n = tables->offset_rev_sym_table[i];
+    if (n < kOffsetSyms) {
+      tables->offset_rev_sym_table[i] = kOffsetCode[n];
+    }
+  }
 
-    unsigned int literal_syms = bit_reader->GetBits(5);
-    if (literal_syms == -1)
-      return -1;
-    literal_syms += 257;
-    if (literal_syms > kLiteralSyms)
-      return -1;
+  for (i = 0; i < kLiteralSyms; i++) {
+    unsigned int n = tables->literals_rev_sym_table[i];
+    if (n >= kMatchLenSymStart && n < kMatchLenSymStart + kMatchLenSyms) {
+      tables->literals_rev_sym_table[i] = kMatchLenCode[n - kMatchLenSymStart];
+    }
+  }
 
-    unsigned int offset_syms = bit_reader->GetBits(5);
-    if (offset_syms == -1)
-      return -1;
-    offset_syms += 1;
-    if (offset_syms > kOffsetSyms)
-      return -1;
+  if (tables->literals_decoder.FinalizeTable(tables->literals_rev_sym_table) < 0)
+    return -1;
+  if (tables->offset_decoder.FinalizeTable(tables->offset_rev_sym_table) < 0)
+    return -1;
 
-    unsigned int code_len_syms = bit_reader->GetBits(4);
-    if (code_len_syms == -1)
-      return -1;
-    code_len_syms += 4;
-    if (code_len_syms > kCodeLenSyms)
-      return -1;
+  tables->literals_decoder.BuildLiteralEntries();
+  tables->offset_decoder.BuildOffsetEntries();
+  return 0;
+}
 
-    if (HuffmanDecoder::ReadRawLengths(kCodeLenBits, code_len_syms, kCodeLenSyms, code_length, bit_reader) < 0)
-      return -1;
-    if (tables_decoder.PrepareTable(tables_rev_sym_table, kCodeLenSyms, kCodeLenSyms, code_length) < 0)
-      return -1;
-    if (tables_decoder.FinalizeTable(tables_rev_sym_table) < 0)
-      return -1;
+/**
+ * Build the tables of the fixed huffman codes
+ *
+ * @return 0 for success, -1 for failure
+ */
+static int BuildFixedTables(BlockTables* tables) {
+  unsigned char fixed_literal_code_len[kLiteralSyms];
+  unsigned char fixed_offset_code_len[kOffsetSyms];
+  int i;
 
-    if (tables_decoder.ReadLength(tables_rev_sym_table, literal_syms + offset_syms, kLiteralSyms + kOffsetSyms, code_length, bit_reader) < 0)
-      return -1;
-    if (literals_decoder.PrepareTable(literals_rev_sym_table, literal_syms, kLiteralSyms, code_length) < 0)
-      return -1;
-    if (offset_decoder.PrepareTable(offset_rev_sym_table, offset_syms, kOffsetSyms, code_length + literal_syms) < 0)
-      return -1;
-  } else {
-    unsigned char fixed_literal_code_len[kLiteralSyms];
-    unsigned char fixed_offset_code_len[kOffsetSyms];
-
-    for (i = 0; i < 144; i++)
-      fixed_literal_code_len[i] = 8;
-    for (; i < 256; i++)
-      fixed_literal_code_len[i] = 9;
-    for (; i < 280; i++)
-      fixed_literal_code_len[i] = 7;
-    for (; i < kLiteralSyms; i++)
-      fixed_literal_code_len[i] = 8;
-
-    for (i = 0; i < kOffsetSyms; i++)
-      fixed_offset_code_len[i] = 5;
-
-    if (literals_decoder.PrepareTable(literals_rev_sym_table, kLiteralSyms, kLiteralSyms, fixed_literal_code_len) < 0)
-      return -1;
-    if (offset_decoder.PrepareTable(offset_rev_sym_table, kOffsetSyms, kOffsetSyms, fixed_offset_code_len) < 0)
-      return -1;
-  }
+  for (i = 0; i < 144; i++)
+    fixed_literal_code_len[i] = 8;
+  for (; i < 256; i++)
+    fixed_literal_code_len[i] = 9;
+  for (; i < 280; i++)
+    fixed_literal_code_len[i] = 7;
+  for (; i < kLiteralSyms; i++)
+    fixed_literal_code_len[i] = 8;
 
-  for (i = 0; i < kOffsetSyms; i++) {
-    unsigned int n = offset_rev_sym_table[i];
-    if (n < kOffsetSyms) {
-      offset_rev_sym_table[i] = kOffsetCode[n];
+  for (i = 0; i < kOffsetSyms; i++)
+    fixed_offset_code_len[i] = 5;
+
+  if (tables->literals_decoder.PrepareTable(tables->literals_rev_sym_table, kLiteralSyms, kLiteralSyms, fixed_literal_code_len) < 0)
+    return -1;
+  if (tables->offset_decoder.PrepareTable(tables->offset_rev_sym_table, kOffsetSyms, kOffsetSyms, fixed_offset_code_len) < 0)
+    return -1;
+
+  return FinalizeBlockTables(tables);
+}
+
+/** @return the fixed huffman tables, built on first use and shared read-only by all threads */
+static const BlockTables* FixedTables() {
+  static const BlockTables* fixed_tables = [] {
+    static BlockTables tables;
+    return BuildFixedTables(&tables) < 0 ? nullptr : &tables;
+  }();
+  return fixed_tables;
+}
+
+/**
+ * Read the code lengths of a block and build its decoding tables
+ *
+ * @param bit_reader bit reader positioned after the block type
+ * @param dynamic_block non-zero for dynamic, zero for fixed huffman codes
+ * @param scratch tables reused from block to block for the dynamic codes
+ *
+ * @return tables to decode the block with, or nullptr for failure
+ */
+const BlockTables* PrepareBlock(BitReader* bit_reader, int dynamic_block, BlockTables* scratch) {
+  if (!dynamic_block)
+    return FixedTables();
+
+  unsigned char code_length[kLiteralSyms + kOffsetSyms];
+
+  unsigned int literal_syms = bit_reader->GetBits(5);
+  if (literal_syms == -1)
+    return nullptr;
+  literal_syms += 257;
+  if (literal_syms > kLiteralSyms)
+    return nullptr;
+
+  unsigned int offset_syms = bit_reader->GetBits(5);
+  if (offset_syms == -1)
+    return nullptr;
+  offset_syms += 1;
+  if (offset_syms > kOffsetSyms)
+    return nullptr;
+
+  unsigned int code_len_syms = bit_reader->GetBits(4);
+  if (code_len_syms == -1)
+    return nullptr;
+  code_len_syms += 4;
+  if (code_len_syms > kCodeLenSyms)
+    return nullptr;
+
+  if (HuffmanDecoder::ReadRawLengths(kCodeLenBits, code_len_syms, kCodeLenSyms, code_length, bit_reader) < 0)
+    return nullptr;
+  if (scratch->code_length_decoder.PrepareTable(scratch->code_length_rev_sym_table, kCodeLenSyms, kCodeLenSyms, code_length) < 0)
+    return nullptr;
+  if (scratch->code_length_decoder.FinalizeTable(scratch->code_length_rev_sym_table) < 0)
+    return nullptr;
+
+  if (scratch->code_length_decoder.ReadLength(scratch->code_length_rev_sym_table, literal_syms + offset_syms, kLiteralSyms + kOffsetSyms, code_length, bit_reader) < 0)
+    return nullptr;
+  if (scratch->literals_decoder.PrepareTable(scratch->literals_rev_sym_table, literal_syms, kLiteralSyms, code_length) < 0)
+    return nullptr;
+  if (scratch->offset_decoder.PrepareTable(scratch->offset_rev_sym_table, offset_syms, kOffsetSyms, code_length + literal_syms) < 0)
+    return nullptr;
+
+  if (FinalizeBlockTables(scratch) < 0)
+    return nullptr;
+  return scratch;
+}
+
+#ifdef X64BIT_SHIFTER
+/**
+ * Fast loop of DecompressBlock. Each iteration checks the margins once and
+ * refills once; the 56 bits it then has cover two literal entries, or a
+ * literal entry and a whole match, so nothing else is checked. It stops at the
+ * margins and at symbols the fast tables cannot take, which the checked path
+ * decodes.
+ *
+ * @param current_out output position, advanced past the decoded bytes
+ *
+ * @return 0 to continue on the checked path, -1 for failure
+ */
+static FORCE_INLINE int DecodeFastBody(BitReader* bit_reader, const BlockTables* tables, const unsigned char* out, unsigned char** current_out, const unsigned char* out_loop_end) {
+  BitReader reader = *bit_reader; /* a local copy stays in registers */
+  unsigned char* out_pos = *current_out;
+
+  while (out_pos < out_loop_end && (reader.GetInBlockEnd() - reader.GetInBlock()) >= kRefillBytes) {
+    reader.RefillFast();
+
+    unsigned int entry = tables->literals_decoder.GetFastEntry(reader.PeekRefilled());
+    if ((entry & kEntryKindMask) == kEntryLiterals) {
+      out_pos[0] = (unsigned char) entry;
+      out_pos[1] = (unsigned char) (entry >> 8);
+      out_pos[2] = (unsigned char) (entry >> 16);
+      out_pos += (entry >> 28) & 3;
+      reader.ConsumeBits((entry >> 24) & 15);
+
+      entry = tables->literals_decoder.GetFastEntry(reader.PeekRefilled());
+      if ((entry & kEntryKindMask) == kEntryLiterals) {
+        out_pos[0] = (unsigned char) entry;
+        out_pos[1] = (unsigned char) (entry >> 8);
+        out_pos[2] = (unsigned char) (entry >> 16);
+        out_pos += (entry >> 28) & 3;
+        reader.ConsumeBits((entry >> 24) & 15);
+        continue;
+      }
     }
-  }
 
-  for (i = 0; i < kLiteralSyms; i++) {
-    unsigned int n = literals_rev_sym_table[i];
-    if (n >= kMatchLenSymStart && n < kLiteralSyms) {
-      literals_rev_sym_table[i] = kMatchLenCode[n - kMatchLenSymStart];
+    if ((entry & kEntryKindMask) != kEntryLength)
+      break;
+
+    reader.ConsumeBits((entry >> 24) & 15);
+    unsigned int extra_bits   = (entry >> 16) & 15;
+    unsigned int match_length = (entry & 0xffff) + (reader.PeekRefilled() & ((1U << extra_bits) - 1));
+    reader.ConsumeBits(extra_bits);
+
+    unsigned int match_offset;
+    unsigned int offset_entry = tables->offset_decoder.GetFastEntry(reader.PeekRefilled());
+    if (offset_entry) {
+      reader.ConsumeBits((offset_entry >> 24) & 15);
+      extra_bits   = (offset_entry >> 20) & 15;
+      match_offset = (offset_entry & 0xffff) + (reader.PeekRefilled() & ((1U << extra_bits) - 1));
+      reader.ConsumeBits(extra_bits);
+    } else {
+      *bit_reader = reader;
+      unsigned int offset_code_word = tables->offset_decoder.ReadValue(tables->offset_rev_sym_table, bit_reader);
+      if (offset_code_word == -1)
+        return -1;
+
+      match_offset = bit_reader->GetBits((offset_code_word >> 16) & 15);
+      if (match_offset == -1)
+        return -1;
+      match_offset += (offset_code_word & 0x7fff);
+      reader = *bit_reader;
     }
+
+    if (match_offset == 0 || match_offset > (unsigned int) (out_pos - out))
+      return -1;
+
+    CopyMatch(out_pos, match_offset, match_length);
+    out_pos += match_length;
   }
 
-  if (literals_decoder.FinalizeTable(literals_rev_sym_table) < 0)
-    return -1;
-  if (offset_decoder.FinalizeTable(offset_rev_sym_table) < 0)
+  *bit_reader  = reader;
+  *current_out = out_pos;
+  return 0;
+}
+
+typedef int (*DecodeFastLoop)(BitReader*, const BlockTables*, const unsigned char*, unsigned char**, const unsigned char*);
+
+static int DecodeFast(BitReader* bit_reader, const BlockTables* tables, const unsigned char* out, unsigned char** current_out, const unsigned char* out_loop_end) {
+  return DecodeFastBody(bit_reader, tables, out, current_out, out_loop_end);
+}
+
+#  ifdef DECOMPRESSOR_BMI2
+/* The same loop with SHRX/SHLX for the variable shifts and BZHI for the extra bit masks */
+TARGET_BMI2 static int DecodeFastBmi2(BitReader* bit_reader, const BlockTables* tables, const unsigned char* out, unsigned char** current_out, const unsigned char* out_loop_end) {
+  return DecodeFastBody(bit_reader, tables, out, current_out, out_loop_end);
+}
+#  endif /* DECOMPRESSOR_BMI2 */
+
+static DecodeFastLoop SelectDecodeFast() {
+#  ifdef DECOMPRESSOR_BMI2
+  if (GetCpuFeatures().bmi2)
+    return DecodeFastBmi2;
+#  endif /* DECOMPRESSOR_BMI2 */
+  return DecodeFast;
+}
+
+static const DecodeFastLoop kDecodeFast = SelectDecodeFast();
+#endif /* X64BIT_SHIFTER */
+
+unsigned int DecompressBlock(BitReader* bit_reader, int dynamic_block, BlockTables* scratch, unsigned char* out, unsigned int out_offset, unsigned int block_size_max) {
+  const BlockTables* tables = PrepareBlock(bit_reader, dynamic_block, scratch);
+  if (!tables)
     return -1;
 
+  const HuffmanDecoder& literals_decoder     = tables->literals_decoder;
+  const HuffmanDecoder& offset_decoder       = tables->offset_decoder;
+  const unsigned int* literals_rev_sym_table = tables->literals_rev_sym_table;
+  const unsigned int* offset_rev_sym_table   = tables->offset_rev_sym_table;
+
   unsigned char* current_out        = out + out_offset;
   const unsigned char* out_end      = current_out + block_size_max;
-  const unsigned char* out_fast_end = out_end - 15;
+  const unsigned char* out_loop_end = block_size_max > kFastLoopOutMargin ? out_end - kFastLoopOutMargin : current_out;
 
   while (true) {
-    bit_reader->Refill32();
+#ifdef X64BIT_SHIFTER
+    if (kDecodeFast(bit_reader, tables, out, &current_out, out_loop_end) < 0)
+      return -1;
+#endif /* X64BIT_SHIFTER */
+
+    bit_reader->Refill();
 
     unsigned int literals_code_word = literals_decoder.ReadValue(literals_rev_sym_table, bit_reader);
     if (literals_code_word < 256) {
@@ -129,7 +303,7 @@ unsigned int DecompressBlock(BitReader* bit_reader, int dynamic_block, unsigned
     } else {
       if (literals_code_word == kEODMarkerSym)
         break;
-      if (literals_code_word == -1)
+      if (literals_code_word == -1 || !(literals_code_word & 0x8000))
         return -1;
 
       unsigned int match_length = bit_reader->GetBits((literals_code_word >> 16) & 15);
@@ -150,19 +324,11 @@ unsigned int DecompressBlock(BitReader* bit_reader, int dynamic_block, unsigned
 
       const unsigned char* src = current_out - match_offset;
       if (src >= out) {
-        if (match_offset >= 16 && (current_out + match_length) <= out_fast_end) {
-          const unsigned char* copy_src     = src;
-          unsigned char* copy_dst           = current_out;
-          const unsigned char* copy_end_dst = current_out + match_length;
-
-          do {
-            std::memcpy(copy_dst, copy_src, 16);
-            copy_src += 16;
-            copy_dst += 16;
-          } while (copy_dst < copy_end_dst);
-
+        if (match_offset && (unsigned int) (out_end - current_out) >= match_length + kMatchCopyOverrun) {
+          CopyMatch(current_out, match_offset, match_length);
           current_out += match_length;
         } else {
+          /* the block's tail, where the copy kernels would overrun the output */
           if ((current_out + match_length) > out_end)
             return -1;
 
@@ -180,100 +346,143 @@ unsigned int DecompressBlock(BitReader* bit_reader, int dynamic_block, unsigned
 
 
 /**
- * Inflate zlib data
+ * Skip the gzip or zlib header; data without either is taken as raw deflate
  *
- * @param compressed_data pointer to start of zlib data
- * @param compressed_data_size size of zlib data, in bytes
- * @param out pointer to start of decompression buffer
- * @param out_size_max maximum size of decompression buffer, in bytes
- * @param checksum defines if the decompressor should use a specific checksum
+ * @param data pointer to start of the compressed data
+ * @param end pointer to end of the compressed data + 1
+ * @param trailer_format set to 1 for the CRC-32 and ISIZE of gzip, 2 for the Adler-32 of zlib, 0 for none
  *
- * @return number of bytes decompressed, or -1 in case of an error
+ * @return pointer to the deflate stream, or nullptr for a malformed header
  */
-unsigned int Decompressor::Feed(const void* compressed_data, unsigned int compressed_data_size, unsigned char* out, unsigned int out_size_max, bool checksum) {
-  auto* current_compressed_data = (unsigned char*) compressed_data;
-  auto* end_compressed_data     = current_compressed_data + compressed_data_size;
-  unsigned int final_block;
-  unsigned int current_out_offset;
-
-  BitReader bit_reader;
+unsigned char* ReadStreamHeader(unsigned char* data, const unsigned char* end, int* trailer_format) {
+  *trailer_format = 0;
 
-  if ((current_compressed_data + 2) > end_compressed_data) {
-    return -1;
-  }
+  if ((data + 2) > end)
+    return nullptr;
 
-  if (current_compressed_data[0] == 0x1f && current_compressed_data[1] == 0x8b) {
-    current_compressed_data += 2;
-    if ((current_compressed_data + 8) > end_compressed_data || current_compressed_data[0] != 0x08) {
-      return -1;
-    }
+  if (data[0] == 0x1f && data[1] == 0x8b) {
+    data += 2;
+    if ((data + 8) > end || data[0] != 0x08)
+      return nullptr;
 
-    current_compressed_data++;
+    data++;
 
-    unsigned char flags = *current_compressed_data++;
-    current_compressed_data += 6;
+    unsigned char flags = *data++;
+    data += 6;
 
-    if (flags & 0x02) {
-      if ((current_compressed_data + 2) > end_compressed_data) {
-        return -1;
-      }
-
-      current_compressed_data += 2;
-    }
+    if (flags & 0x20)
+      return nullptr;
 
     if (flags & 0x04) {
-      if ((current_compressed_data + 2) > end_compressed_data) {
-        return -1;
-      }
+      if ((data + 2) > end)
+        return nullptr;
 
-      unsigned short extra_field_len = ((unsigned short) current_compressed_data[0]) | (((unsigned short) current_compressed_data[1]) << 8);
-      current_compressed_data += 2;
+      unsigned short extra_field_len = ((unsigned short) data[0]) | (((unsigned short) data[1]) << 8);
+      data += 2;
 
-      if ((current_compressed_data + extra_field_len) > end_compressed_data) {
-        return -1;
-      }
+      if ((data + extra_field_len) > end)
+        return nullptr;
 
-      current_compressed_data += extra_field_len;
+      data += extra_field_len;
     }
 
-    if (flags & 0x08) {
-      do {
-        if (current_compressed_data >= end_compressed_data) {
-          return -1;
-        }
+    /* file name, then comment */
+    for (unsigned char zero_terminated : {0x08, 0x10}) {
+      if (flags & zero_terminated) {
+        do {
+          if (data >= end)
+            return nullptr;
 
-        current_compressed_data++;
-      } while (current_compressed_data[-1]);
+          data++;
+        } while (data[-1]);
+      }
     }
 
-    if (flags & 0x10) {
-      do {
-        if (current_compressed_data >= end_compressed_data)
-          return -1;
+    if (flags & 0x02) {
+      if ((data + 2) > end)
+        return nullptr;
 
-        current_compressed_data++;
-      } while (current_compressed_data[-1]);
+      data += 2;
     }
 
-    if (flags & 0x20)
-      return -1;
-
-  } else if ((current_compressed_data[0] & 0x0f) == 0x08) {
-    unsigned char CMF    = current_compressed_data[0];
-    unsigned char FLG    = current_compressed_data[1];
+    *trailer_format = 1;
+  } else if ((data[0] & 0x0f) == 0x08) {
+    unsigned char CMF    = data[0];
+    unsigned char FLG    = data[1];
     unsigned short check = FLG | (((unsigned short) CMF) << 8);
 
     if ((CMF >> 4) <= 7 && (check % 31) == 0) {
-      current_compressed_data += 2;
+      data += 2;
       if (FLG & 0x20) {
-        if ((current_compressed_data + 4) > end_compressed_data) {
-          return -1;
-        }
-        current_compressed_data += 4;
+        if ((data + 4) > end)
+          return nullptr;
+        data += 4;
       }
+      *trailer_format = 2;
     }
   }
 
+  return data;
+}
+
+/**
+ * Compare the gzip or zlib trailer with the inflated data
+ *
+ * @param trailer pointer to the byte following the deflate stream
+ * @param end pointer to end of the compressed data + 1
+ * @param trailer_format as set by ReadStreamHeader()
+ * @param checksum CRC-32 for gzip, Adler-32 for zlib
+ * @param size number of bytes inflated
+ *
+ * @return 0 when they match, -1 otherwise
+ */
+int CheckTrailer(const unsigned char* trailer, const unsigned char* end, int trailer_format, unsigned int checksum, unsigned int size) {
+  if (trailer_format == 1) {
+    if ((trailer + 8) > end)
+      return -1;
+
+    unsigned int stored_crc   = ((unsigned int) trailer[0]) | (((unsigned int) trailer[1]) << 8) | (((unsigned int) trailer[2]) << 16) | (((unsigned int) trailer[3]) << 24);
+    unsigned int stored_isize = ((unsigned int) trailer[4]) | (((unsigned int) trailer[5]) << 8) | (((unsigned int) trailer[6]) << 16) | (((unsigned int) trailer[7]) << 24);
+    if (stored_crc != checksum || stored_isize != size)
+      return -1;
+  } else if (trailer_format == 2) {
+    if ((trailer + 4) > end)
+      return -1;
+
+    unsigned int stored_adler = (((unsigned int) trailer[0]) << 24) | (((unsigned int) trailer[1]) << 16) | (((unsigned int) trailer[2]) << 8) | ((unsigned int) trailer[3]);
+    if (stored_adler != checksum)
+      return -1;
+  }
+
+  return 0;
+}
+
+/**
+ * Inflate zlib data
+ *
+ * @param compressed_data pointer to start of zlib data
+ * @param compressed_data_size size of zlib data, in bytes
+ * @param out pointer to start of decompression buffer
+ * @param out_size_max maximum size of decompression buffer, in bytes
+ * @param checksum whether to verify the gzip CRC-32 or zlib Adler-32 trailer
+ *
+ * @return number of bytes decompressed, or -1 in case of an error
+ */
+unsigned int Decompressor::Feed(const void* compressed_data, unsigned int compressed_data_size, unsigned char* out, unsigned int out_size_max, bool checksum) {
+  auto* current_compressed_data = (unsigned char*) compressed_data;
+  auto* end_compressed_data     = current_compressed_data + compressed_data_size;
+  unsigned int final_block;
+  unsigned int current_out_offset;
+  int trailer_format = 0; /* 1 for the CRC-32 and ISIZE of gzip, 2 for the Adler-32 of zlib */
+  unsigned int crc   = 0;
+  unsigned int adler = 1;
+
+  BitReader bit_reader;
+  BlockTables scratch;
+
+  current_compressed_data = ReadStreamHeader(current_compressed_data, end_compressed_data, &trailer_format);
+  if (!current_compressed_data)
+    return -1;
 
   bit_reader.Init(current_compressed_data, end_compressed_data);
   current_out_offset = 0;
@@ -291,11 +500,11 @@ unsigned int Decompressor::Feed(const void* compressed_data, unsigned int compre
         break;
 
       case 1:
-        block_result = DecompressBlock(&bit_reader, 0, out, current_out_offset, out_size_max - current_out_offset);
+        block_result = DecompressBlock(&bit_reader, 0, &scratch, out, current_out_offset, out_size_max - current_out_offset);
         break;
 
       case 2:
-        block_result = DecompressBlock(&bit_reader, 1, out, current_out_offset, out_size_max - current_out_offset);
+        block_result = DecompressBlock(&bit_reader, 1, &scratch, out, current_out_offset, out_size_max - current_out_offset);
         break;
 
       case 3:
@@ -306,11 +515,38 @@ unsigned int Decompressor::Feed(const void* compressed_data, unsigned int compre
       return -1;
     }
 
+    /* checksum the block while its output is still in cache */
+    if (checksum && trailer_format == 1)
+      crc = Crc32(crc, out + current_out_offset, block_result);
+    else if (checksum && trailer_format == 2)
+      adler = Adler32(adler, out + current_out_offset, block_result);
+
     current_out_offset += block_result;
   } while (!final_block);
 
   bit_reader.ByteAllign();
   current_compressed_data = bit_reader.GetInBlock();
 
+  if (checksum && CheckTrailer(current_compressed_data, end_compressed_data, trailer_format, trailer_format == 1 ? crc : adler, current_out_offset) < 0)
+    return -1;
+
   return current_out_offset;
 }
+
+/**
+ * Read the uncompressed size from the ISIZE trailer of a gzip member
+ *
+ * @param compressed_data pointer to start of gzip data
+ * @param compressed_data_size size of gzip data, in bytes
+ *
+ * @return size modulo 2^32 as stored by the compressor, or -1 for data that is not gzip
+ */
+unsigned int Decompressor::InflatedSize(const void* compressed_data, unsigned int compressed_data_size) {
+  auto* data = (const unsigned char*) compressed_data;
+
+  if (compressed_data_size < 18 || data[0] != 0x1f || data[1] != 0x8b)
+    return -1;
+
+  const unsigned char* isize = data + compressed_data_size - 4;
+  return ((unsigned int) isize[0]) | (((unsigned int) isize[1]) << 8) | (((unsigned int) isize[2]) << 16) | (((unsigned int) isize[3]) << 24);
+}
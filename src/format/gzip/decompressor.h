@@ -20,6 +20,9 @@ constexpr auto kMatchLenSyms     = 29;
 constexpr auto kOffsetSyms       = 32;
 constexpr auto kMinMatchSize     = 3;
 
+/*-- fewest compressed bytes FeedParallel decodes as a chunk of their own --*/
+constexpr unsigned int kParallelChunkSize = 4 << 20;
+
 constexpr unsigned int kMatchLenCode[kMatchLenSyms] = {
     MATCHLEN_PAIR(kMinMatchSize + 0, 0),
     MATCHLEN_PAIR(kMinMatchSize + 1, 0),
@@ -85,12 +88,31 @@ constexpr unsigned int kOffsetCode[kOffsetSyms] = {
     OFFSET_PAIR(24577, 13),
 };
 
+/*-- decoding tables of a huffman block, either the shared fixed ones or scratch rebuilt per dynamic block --*/
+struct BlockTables {
+  HuffmanDecoder literals_decoder;
+  HuffmanDecoder offset_decoder;
+  unsigned int literals_rev_sym_table[kLiteralSyms * 2];
+  unsigned int offset_rev_sym_table[kLiteralSyms * 2];
+
+  HuffmanDecoder code_length_decoder;
+  unsigned int code_length_rev_sym_table[kCodeLenSyms * 2];
+};
+
+const BlockTables* PrepareBlock(BitReader*, int, BlockTables*);
+unsigned int CopyStored(BitReader*, unsigned char*, unsigned int, unsigned int);
+unsigned int DecompressBlock(BitReader*, int, BlockTables*, unsigned char*, unsigned int, unsigned int);
+unsigned char* ReadStreamHeader(unsigned char*, const unsigned char*, int*);
+int CheckTrailer(const unsigned char*, const unsigned char*, int, unsigned int, unsigned int);
+
 class Decompressor {
 public:
   Decompressor()  = default;
   ~Decompressor() = default;
 
   static unsigned int Feed(const void*, unsigned int, unsigned char*, unsigned int, bool);
+  static unsigned int FeedParallel(const void*, unsigned int, unsigned char*, unsigned int, bool, unsigned int, unsigned int = kParallelChunkSize);
+  static unsigned int InflatedSize(const void*, unsigned int);
 };
 
 #endif /* !_DECOMPRESSOR_H */
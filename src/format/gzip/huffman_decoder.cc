@@ -106,6 +106,76 @@ int HuffmanDecoder::FinalizeTable(unsigned int* rev_symbol_table) {
   return 0;
 }
 
+/**
+ * Build the literal/length fast entries from a finalized table. Codes short
+ * enough to share one lookup are packed, up to three literals per entry, and
+ * the extra bits of a match length are folded in when they fit as well.
+ * Must run after FinalizeTable() of a table mapped to kMatchLenCode values.
+ */
+void HuffmanDecoder::BuildLiteralEntries() {
+  for (unsigned int i = 0; i < (1 << kFastSymbolBits); i++) {
+    unsigned int fast_sym_bits = this->fast_symbol_[i];
+    unsigned int symbol        = fast_sym_bits & 0xffffff;
+    unsigned int used          = fast_sym_bits >> 24;
+    unsigned int entry         = 0;
+
+    if (!fast_sym_bits) {
+      /* longer code, decoded by ReadValue() */
+    } else if (symbol < 256) {
+      unsigned int literals = symbol;
+      unsigned int count    = 1;
+
+      /* the following codes are only known when they fit in the remaining lookup bits */
+      while (count < 3) {
+        unsigned int next = this->fast_symbol_[i >> used];
+        if (!next || (next & 0xffffff) >= 256 || used + (next >> 24) > kFastSymbolBits)
+          break;
+        literals |= (next & 0xff) << (8 * count++);
+        used += next >> 24;
+      }
+
+      entry = kEntryLiterals | (count << 28) | (used << 24) | literals;
+    } else if (symbol == 256) {
+      entry = kEntryEnd | (used << 24);
+    } else if (symbol & 0x8000) {
+      unsigned int base  = symbol & 0x7fff;
+      unsigned int extra = (symbol >> 16) & 15;
+
+      if (used + extra <= kFastSymbolBits)
+        entry = kEntryLength | ((used + extra) << 24) | (base + ((i >> used) & ((1U << extra) - 1)));
+      else
+        entry = kEntryLength | (used << 24) | (extra << 16) | base;
+    }
+
+    this->fast_entry_[i] = entry;
+  }
+}
+
+/**
+ * Build the offset fast entries from a finalized table mapped to kOffsetCode
+ * values: offset in bits 0..15, extra bits still to read in 20..23, bits
+ * consumed in 24..27. Extra bits are folded in when they fit in the lookup.
+ */
+void HuffmanDecoder::BuildOffsetEntries() {
+  for (unsigned int i = 0; i < (1 << kFastSymbolBits); i++) {
+    unsigned int fast_sym_bits = this->fast_symbol_[i];
+    unsigned int base          = fast_sym_bits & 0x7fff;
+    unsigned int extra         = (fast_sym_bits >> 16) & 15;
+    unsigned int used          = fast_sym_bits >> 24;
+    unsigned int entry         = 0;
+
+    /* an offset of 0 comes from the two unused codes, left to ReadValue() to reject */
+    if (fast_sym_bits && base) {
+      if (used + extra <= kFastSymbolBits)
+        entry = ((used + extra) << 24) | (base + ((i >> used) & ((1U << extra) - 1)));
+      else
+        entry = (used << 24) | (extra << 20) | base;
+    }
+
+    this->fast_entry_[i] = entry;
+  }
+}
+
 /**
  * Read fixed bit size code lengths
  *
@@ -209,7 +279,7 @@ int HuffmanDecoder::ReadLength(const unsigned int* tables_rev_symbol_table, cons
  *
  * @return symbol, or -1 for error
  */
-unsigned int HuffmanDecoder::ReadValue(const unsigned int* rev_symbol_table, BitReader* bit_reader) {
+unsigned int HuffmanDecoder::ReadValue(const unsigned int* rev_symbol_table, BitReader* bit_reader) const {
   unsigned int stream        = bit_reader->PeekBits();
   unsigned int fast_sym_bits = this->fast_symbol_[stream & ((1 << kFastSymbolBits) - 1)];
   if (fast_sym_bits) {
@@ -5,7 +5,13 @@
 
 constexpr auto kMaxSymbols     = 288;
 constexpr auto kCodeLenSyms    = 19;
-constexpr auto kFastSymbolBits = 10;
+constexpr auto kFastSymbolBits = 11;
+
+/*-- fast entries: kind in bits 30..31, bits consumed in 24..27, payload below --*/
+constexpr unsigned int kEntryKindMask = 3U << 30;
+constexpr unsigned int kEntryLiterals = 1U << 30; /* 1 to 3 literal bytes, count in bits 28..29 */
+constexpr unsigned int kEntryLength   = 2U << 30; /* match length, extra bits still to read in 16..19 */
+constexpr unsigned int kEntryEnd      = 3U << 30; /* end of block */
 
 class HuffmanDecoder {
 public:
@@ -14,13 +20,21 @@ public:
 
   int PrepareTable(unsigned int*, const int, const int, unsigned char*);
   int FinalizeTable(unsigned int*);
+  void BuildLiteralEntries();
+  void BuildOffsetEntries();
   static int ReadRawLengths(const int, const int, const int, unsigned char*, BitReader*);
   int ReadLength(const unsigned int*, const int, const int, unsigned char*, BitReader*);
 
-  unsigned int ReadValue(const unsigned int*, BitReader*);
+  unsigned int ReadValue(const unsigned int*, BitReader*) const;
+
+  /** @return fast entry for the next kFastSymbolBits of stream, 0 when the code is longer */
+  unsigned int GetFastEntry(unsigned int stream) const {
+    return this->fast_entry_[stream & ((1 << kFastSymbolBits) - 1)];
+  };
 
 private:
   unsigned int fast_symbol_[1 << kFastSymbolBits];
+  unsigned int fast_entry_[1 << kFastSymbolBits];
   unsigned int start_index_[16];
   unsigned int symbols_;
   int num_sorted_;
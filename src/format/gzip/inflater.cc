@@ -0,0 +1,409 @@
+#include "inflater.h"
+
+#include <algorithm>
+
+#include "checksum.h"
+#include "match_copy.h"
+
+/* Upper bound of the bits needed by a block header, i.e. the largest dynamic table description */
+constexpr auto kMaxBlockHeaderBits = 3 + 14 + kCodeLenSyms * kCodeLenBits + (kLiteralSyms + kOffsetSyms) * 14;
+/* Upper bound of the bits needed by one literal or match: two codes and their extra bits */
+constexpr auto kMaxSymbolBits = 15 + 5 + 15 + 13;
+/* Bytes of a new chunk joined with the unread end of the previous one */
+constexpr size_t kStitchSize = 4096;
+
+/**
+ * @param on_output receives each run of inflated bytes
+ * @param checksum whether to verify the gzip CRC-32 or zlib Adler-32 trailer
+ */
+Inflater::Inflater(OutputCallback on_output, bool checksum)
+    : on_output_(std::move(on_output)), checksum_(checksum), window_(kWindowBufferSize + kMatchCopyOverrun) {}
+
+/**
+ * Inflate the next chunk of compressed data. Output is passed to the callback
+ * before returning; bytes that cannot be decoded yet are kept for the next call.
+ *
+ * @param data pointer to the chunk
+ * @param size size of the chunk, in bytes
+ *
+ * @return 0 for success, -1 for failure
+ */
+int Inflater::Feed(const void* data, size_t size) {
+  auto* in  = static_cast<unsigned char*>(const_cast<void*>(data));
+  auto* end = in + size;
+
+  if (this->state_ == State::kError)
+    return -1;
+
+  if (!this->pending_.empty()) {
+    /* decode what is left of the previous chunk joined with the start of this one */
+    size_t pending = this->pending_.size();
+    size_t stitch  = std::min(size, kStitchSize);
+    this->pending_.insert(this->pending_.end(), in, in + stitch);
+    this->bit_reader_.Rebase(this->pending_.data(), this->pending_.data() + this->pending_.size());
+    if (this->Run(false) < 0)
+      return -1;
+
+    size_t used = this->bit_reader_.GetInBlock() - this->pending_.data();
+    if (used < pending) {
+      this->pending_.erase(this->pending_.begin(), this->pending_.begin() + (long) used);
+      this->pending_.insert(this->pending_.end(), in + stitch, end);
+      this->Flush();
+      return 0;
+    }
+
+    in += used - pending;
+    this->pending_.clear();
+  }
+
+  this->bit_reader_.Rebase(in, end);
+  if (this->Run(false) < 0)
+    return -1;
+
+  this->pending_.assign(this->bit_reader_.GetInBlock(), end);
+  this->Flush();
+  return 0;
+}
+
+/**
+ * Signal the end of the compressed data and inflate what is left
+ *
+ * @return 0 when the stream was complete, -1 otherwise
+ */
+int Inflater::Finish() {
+  if (this->state_ == State::kError)
+    return -1;
+
+  this->bit_reader_.Rebase(this->pending_.data(), this->pending_.data() + this->pending_.size());
+  int result = this->Run(true);
+  this->pending_.clear();
+  this->Flush();
+
+  return (result < 0 || this->state_ != State::kDone) ? -1 : 0;
+}
+
+/**
+ * Advance the state machine as far as the buffered input allows
+ *
+ * @param final whether no more input follows
+ *
+ * @return 0 when waiting for input or done, -1 for failure
+ */
+int Inflater::Run(bool final) {
+  while (true) {
+    int result = -1;
+
+    switch (this->state_) {
+      case State::kHeader:
+        result = this->ReadHeader(final);
+        break;
+
+      case State::kBlockHeader:
+        result = this->ReadBlockHeader(final);
+        break;
+
+      case State::kStored:
+        result = this->CopyStored(final);
+        break;
+
+      case State::kHuffman:
+        result = this->DecodeSymbols(final);
+        break;
+
+      case State::kTrailer:
+        result = this->ReadTrailer(final);
+        break;
+
+      case State::kDone:
+        return 0;
+
+      case State::kError:
+        return -1;
+    }
+
+    if (result < 0) {
+      this->state_ = State::kError;
+      return -1;
+    }
+    if (result == 0)
+      return 0;
+  }
+}
+
+/**
+ * Skip the gzip or zlib header; data without either is taken as raw deflate
+ *
+ * @return 1 when done, 0 when more input is needed, -1 for failure
+ */
+int Inflater::ReadHeader(bool final) {
+  const int need_input           = final ? -1 : 0;
+  unsigned char* in              = this->bit_reader_.GetInBlock();
+  const unsigned char* end       = this->bit_reader_.GetInBlockEnd();
+  const unsigned char* current   = in;
+
+  if ((end - in) < 2)
+    return need_input;
+
+  if (in[0] == 0x1f && in[1] == 0x8b) {
+    if ((end - in) < 10)
+      return need_input;
+    if (in[2] != 0x08)
+      return -1;
+
+    unsigned char flags = in[3];
+    if (flags & 0xe0)
+      return -1;
+    current += 10;
+
+    if (flags & 0x04) {
+      if ((end - current) < 2)
+        return need_input;
+
+      unsigned short extra_field_len = ((unsigned short) current[0]) | (((unsigned short) current[1]) << 8);
+      current += 2;
+      if ((end - current) < extra_field_len)
+        return need_input;
+      current += extra_field_len;
+    }
+
+    for (unsigned char zero_terminated : {0x08, 0x10}) {
+      if (flags & zero_terminated) {
+        while (current < end && *current)
+          current++;
+        if (current == end)
+          return need_input;
+        current++;
+      }
+    }
+
+    if (flags & 0x02) {
+      if ((end - current) < 2)
+        return need_input;
+      current += 2;
+    }
+
+    this->format_       = Format::kGzip;
+    this->trailer_size_ = 8;
+  } else if ((in[0] & 0x0f) == 0x08 && (in[0] >> 4) <= 7 && ((((unsigned short) in[0]) << 8) | in[1]) % 31 == 0) {
+    if (in[1] & 0x20)
+      return -1; /* preset dictionaries are not supported */
+
+    current += 2;
+    this->format_       = Format::kZlib;
+    this->trailer_size_ = 4;
+  }
+
+  this->bit_reader_.ModifyInBlock((int) (current - in));
+  this->state_ = State::kBlockHeader;
+  return 1;
+}
+
+/**
+ * Read the block type and prepare stored copying or the huffman tables
+ *
+ * @return 1 when done, 0 when more input is needed, -1 for failure
+ */
+int Inflater::ReadBlockHeader(bool final) {
+  if (!final && this->bit_reader_.GetAvailableBits() < kMaxBlockHeaderBits)
+    return 0;
+
+  this->final_block_      = (int) this->bit_reader_.GetBits(1);
+  unsigned int block_type = this->bit_reader_.GetBits(2);
+
+  switch (block_type) {
+    case 0: {
+      this->bit_reader_.SkipToByte();
+      unsigned int stored_length     = this->bit_reader_.GetBits(16);
+      unsigned int neg_stored_length = this->bit_reader_.GetBits(16);
+      if (stored_length != ((~neg_stored_length) & 0xffff))
+        return -1;
+
+      this->stored_remaining_ = stored_length;
+      this->state_            = State::kStored;
+      break;
+    }
+
+    case 1:
+    case 2:
+      this->tables_ = PrepareBlock(&this->bit_reader_, block_type == 2, &this->scratch_);
+      if (!this->tables_)
+        return -1;
+      this->state_ = State::kHuffman;
+      break;
+
+    default:
+      return -1;
+  }
+
+  return this->bit_reader_.GetAvailableBits() < 0 ? -1 : 1;
+}
+
+/**
+ * Copy the bytes of a stored block, as many as are available
+ *
+ * @return 1 when done, 0 when more input is needed, -1 for failure
+ */
+int Inflater::CopyStored(bool final) {
+  while (this->stored_remaining_) {
+    if (this->out_pos_ == kWindowBufferSize)
+      this->Slide();
+
+    if (this->bit_reader_.GetBitCount() >= 8) {
+      this->window_[this->out_pos_++] = (unsigned char) this->bit_reader_.GetBits(8);
+      this->stored_remaining_--;
+      continue;
+    }
+
+    size_t available = this->bit_reader_.GetInBlockEnd() - this->bit_reader_.GetInBlock();
+    if (!available)
+      return final ? -1 : 0;
+
+    size_t n = std::min({(size_t) this->stored_remaining_, available, (size_t) (kWindowBufferSize - this->out_pos_)});
+    std::memcpy(this->window_.data() + this->out_pos_, this->bit_reader_.GetInBlock(), n);
+    this->bit_reader_.ModifyInBlock((int) n);
+    this->out_pos_ += n;
+    this->stored_remaining_ -= n;
+  }
+
+  this->state_ = this->final_block_ ? State::kTrailer : State::kBlockHeader;
+  return 1;
+}
+
+/**
+ * Decode literals and matches of a huffman block into the window
+ *
+ * @return 1 when the block ended, 0 when more input is needed, -1 for failure
+ */
+int Inflater::DecodeSymbols(bool final) {
+  BitReader* bit_reader = &this->bit_reader_;
+  unsigned char* window = this->window_.data();
+  unsigned int out_pos  = this->out_pos_;
+
+  while (true) {
+    if (!final && bit_reader->GetAvailableBits() < kMaxSymbolBits) {
+      this->out_pos_ = out_pos;
+      return 0;
+    }
+
+    if (out_pos > kWindowBufferSize - kMaxMatchSize) {
+      this->out_pos_ = out_pos;
+      this->Slide();
+      out_pos = this->out_pos_;
+    }
+
+    bit_reader->Refill();
+
+    /* up to three literals in one lookup; the window is padded for the unused bytes */
+    unsigned int entry = this->tables_->literals_decoder.GetFastEntry(bit_reader->PeekBits());
+    if ((entry & kEntryKindMask) == kEntryLiterals) {
+      window[out_pos]     = (unsigned char) entry;
+      window[out_pos + 1] = (unsigned char) (entry >> 8);
+      window[out_pos + 2] = (unsigned char) (entry >> 16);
+      out_pos += (entry >> 28) & 3;
+      bit_reader->ConsumeBits((entry >> 24) & 15);
+      if (final && bit_reader->GetAvailableBits() < 0)
+        return -1;
+      continue;
+    }
+
+    unsigned int literals_code_word = this->tables_->literals_decoder.ReadValue(this->tables_->literals_rev_sym_table, bit_reader);
+    if (literals_code_word < 256) {
+      window[out_pos++] = (unsigned char) literals_code_word;
+    } else if (literals_code_word == kEODMarkerSym) {
+      break;
+    } else {
+      if (literals_code_word == -1 || !(literals_code_word & 0x8000))
+        return -1;
+
+      unsigned int match_length = bit_reader->GetBits((literals_code_word >> 16) & 15);
+      if (match_length == -1)
+        return -1;
+      match_length += (literals_code_word & 0x7fff);
+
+      unsigned int offset_code_word = this->tables_->offset_decoder.ReadValue(this->tables_->offset_rev_sym_table, bit_reader);
+      if (offset_code_word == -1)
+        return -1;
+
+      unsigned int match_offset = bit_reader->GetBits((offset_code_word >> 16) & 15);
+      if (match_offset == -1)
+        return -1;
+      match_offset += (offset_code_word & 0x7fff);
+
+      if (match_offset == 0 || match_offset > out_pos)
+        return -1;
+
+      CopyMatch(window + out_pos, match_offset, match_length);
+      out_pos += match_length;
+    }
+
+    if (final && bit_reader->GetAvailableBits() < 0)
+      return -1;
+  }
+
+  this->out_pos_ = out_pos;
+  this->state_   = this->final_block_ ? State::kTrailer : State::kBlockHeader;
+  return 1;
+}
+
+/**
+ * Read the gzip or zlib trailer and check the length and checksum
+ *
+ * @return 1 when done, 0 when more input is needed, -1 for failure
+ */
+int Inflater::ReadTrailer(bool final) {
+  this->bit_reader_.SkipToByte();
+
+  while (this->trailer_have_ < this->trailer_size_) {
+    if (this->bit_reader_.GetBitCount() >= 8) {
+      this->trailer_[this->trailer_have_++] = (unsigned char) this->bit_reader_.GetBits(8);
+    } else if (this->bit_reader_.GetInBlock() < this->bit_reader_.GetInBlockEnd()) {
+      this->trailer_[this->trailer_have_++] = *this->bit_reader_.GetInBlock();
+      this->bit_reader_.ModifyInBlock(1);
+    } else {
+      return final ? -1 : 0;
+    }
+  }
+
+  this->Flush();
+  if (this->format_ == Format::kGzip) {
+    unsigned int crc   = ((unsigned int) this->trailer_[0]) | (((unsigned int) this->trailer_[1]) << 8) |
+                       (((unsigned int) this->trailer_[2]) << 16) | (((unsigned int) this->trailer_[3]) << 24);
+    unsigned int isize = ((unsigned int) this->trailer_[4]) | (((unsigned int) this->trailer_[5]) << 8) |
+                         (((unsigned int) this->trailer_[6]) << 16) | (((unsigned int) this->trailer_[7]) << 24);
+    if (isize != (unsigned int) this->total_out_ || (this->checksum_ && crc != this->crc_))
+      return -1;
+  } else if (this->format_ == Format::kZlib) {
+    unsigned int adler = (((unsigned int) this->trailer_[0]) << 24) | (((unsigned int) this->trailer_[1]) << 16) |
+                         (((unsigned int) this->trailer_[2]) << 8) | ((unsigned int) this->trailer_[3]);
+    if (this->checksum_ && adler != this->adler_)
+      return -1;
+  }
+
+  this->state_ = State::kDone;
+  return 1;
+}
+
+/** Hand the output produced since the last flush to the callback and add it to the checksum */
+void Inflater::Flush() {
+  if (this->out_pos_ > this->flushed_) {
+    const unsigned char* output = this->window_.data() + this->flushed_;
+    size_t size                 = this->out_pos_ - this->flushed_;
+
+    if (this->checksum_ && this->format_ == Format::kGzip)
+      this->crc_ = Crc32(this->crc_, output, size);
+    else if (this->checksum_ && this->format_ == Format::kZlib)
+      this->adler_ = Adler32(this->adler_, output, size);
+
+    this->on_output_(output, size);
+    this->total_out_ += size;
+    this->flushed_ = this->out_pos_;
+  }
+}
+
+/** Flush and move the last 32 KB, the furthest a match can reach back, to the start of the window */
+void Inflater::Slide() {
+  this->Flush();
+  std::memmove(this->window_.data(), this->window_.data() + this->out_pos_ - kWindowSize, kWindowSize);
+  this->out_pos_ = kWindowSize;
+  this->flushed_ = kWindowSize;
+}
@@ -0,0 +1,85 @@
+#ifndef _INFLATER_H
+#define _INFLATER_H
+
+#include <functional>
+#include <vector>
+
+#include "bit_reader.h"
+#include "decompressor.h"
+#include "huffman_decoder.h"
+
+constexpr auto kWindowSize       = 32768;
+constexpr auto kWindowBufferSize = kWindowSize * 4;
+constexpr auto kMaxMatchSize     = 258;
+
+/**
+ * Streaming gzip, zlib or raw deflate inflater. Compressed data is fed in chunks
+ * of any size; blocks, codes and headers may span chunks. Output is produced
+ * into a 32 KB sliding window and handed to the callback as it becomes
+ * available, so memory stays bounded no matter how large the stream is. The
+ * gzip CRC-32 or zlib Adler-32 is checked against the trailer unless disabled.
+ */
+class Inflater {
+public:
+  using OutputCallback = std::function<void(const unsigned char*, size_t)>;
+
+  explicit Inflater(OutputCallback, bool = true);
+  ~Inflater() = default;
+
+  int Feed(const void*, size_t);
+  int Finish();
+
+  bool Done() const {
+    return this->state_ == State::kDone;
+  };
+  unsigned long long GetTotalOut() const {
+    return this->total_out_;
+  };
+
+private:
+  enum class State { kHeader,
+    kBlockHeader,
+    kStored,
+    kHuffman,
+    kTrailer,
+    kDone,
+    kError };
+
+  enum class Format { kGzip,
+    kZlib,
+    kRaw };
+
+  int Run(bool);
+  int ReadHeader(bool);
+  int ReadBlockHeader(bool);
+  int CopyStored(bool);
+  int DecodeSymbols(bool);
+  int ReadTrailer(bool);
+  void Flush();
+  void Slide();
+
+  OutputCallback on_output_;
+  bool checksum_;
+  State state_   = State::kHeader;
+  Format format_ = Format::kRaw;
+  BitReader bit_reader_;
+  std::vector<unsigned char> pending_;
+
+  int final_block_                  = 0;
+  unsigned int stored_remaining_    = 0;
+  unsigned char trailer_[8]         = {};
+  unsigned int trailer_size_        = 0;
+  unsigned int trailer_have_        = 0;
+  unsigned long long total_out_     = 0;
+  unsigned int crc_                 = 0;
+  unsigned int adler_               = 1;
+
+  BlockTables scratch_;
+  const BlockTables* tables_ = nullptr;
+
+  std::vector<unsigned char> window_;
+  unsigned int out_pos_ = 0;
+  unsigned int flushed_ = 0;
+};
+
+#endif /* !_INFLATER_H */
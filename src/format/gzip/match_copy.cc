@@ -0,0 +1,148 @@
+#include "match_copy.h"
+
+#include "cpu_features.h"
+
+#include <array>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#  define MATCH_COPY_X86
+#  include <immintrin.h>
+#  ifdef _MSC_VER
+#    define TARGET_SSSE3
+#    define TARGET_AVX2
+#  else
+#    define TARGET_SSSE3 __attribute__((target("ssse3")))
+#    define TARGET_AVX2 __attribute__((target("avx2")))
+#  endif
+#elif defined(__aarch64__)
+#  define MATCH_COPY_NEON
+#  include <arm_neon.h>
+#endif
+
+/*
+ * For an offset below 16 the first offset bytes of the source repeat: mask
+ * [offset][i] picks byte i % offset to expand them into a 32 byte pattern, which
+ * stays in phase when stored at a stride that is a multiple of the offset.
+ */
+struct PatternTables {
+  alignas(32) unsigned char masks[16][32];
+  unsigned int strides16[16];
+  unsigned int strides32[16];
+};
+
+constexpr PatternTables MakePatternTables() {
+  PatternTables tables{};
+  for (unsigned int offset = 1; offset < 16; offset++) {
+    for (unsigned int i = 0; i < 32; i++)
+      tables.masks[offset][i] = (unsigned char) (i % offset);
+    tables.strides16[offset] = 16 / offset * offset;
+    tables.strides32[offset] = 32 / offset * offset;
+  }
+  return tables;
+}
+
+constexpr PatternTables kPatterns = MakePatternTables();
+
+static void CopyMatchScalar(unsigned char* dst, unsigned int offset, unsigned int length) {
+  const unsigned char* src = dst - offset;
+  const unsigned char* end = dst + length;
+
+  if (offset >= 8) {
+    do {
+      std::memcpy(dst, src, 8);
+      src += 8;
+      dst += 8;
+    } while (dst < end);
+  } else {
+    while (dst < end)
+      *dst++ = *src++;
+  }
+}
+
+#ifdef MATCH_COPY_X86
+TARGET_SSSE3 static void CopyMatchSsse3(unsigned char* dst, unsigned int offset, unsigned int length) {
+  const unsigned char* end = dst + length;
+
+  if (offset >= 16) {
+    do {
+      _mm_storeu_si128((__m128i*) dst, _mm_loadu_si128((const __m128i*) (dst - offset)));
+      dst += 16;
+    } while (dst < end);
+    return;
+  }
+
+  const __m128i source  = _mm_loadu_si128((const __m128i*) (dst - offset));
+  const __m128i pattern = _mm_shuffle_epi8(source, _mm_load_si128((const __m128i*) kPatterns.masks[offset]));
+  const unsigned int stride = kPatterns.strides16[offset];
+  do {
+    _mm_storeu_si128((__m128i*) dst, pattern);
+    dst += stride;
+  } while (dst < end);
+}
+
+TARGET_AVX2 static void CopyMatchAvx2(unsigned char* dst, unsigned int offset, unsigned int length) {
+  const unsigned char* end = dst + length;
+
+  if (offset >= 32) {
+    do {
+      _mm256_storeu_si256((__m256i*) dst, _mm256_loadu_si256((const __m256i*) (dst - offset)));
+      dst += 32;
+    } while (dst < end);
+    return;
+  }
+
+  if (offset >= 16) {
+    do {
+      _mm_storeu_si128((__m128i*) dst, _mm_loadu_si128((const __m128i*) (dst - offset)));
+      dst += 16;
+    } while (dst < end);
+    return;
+  }
+
+  const __m128i source = _mm_loadu_si128((const __m128i*) (dst - offset));
+  const __m128i low    = _mm_shuffle_epi8(source, _mm_load_si128((const __m128i*) kPatterns.masks[offset]));
+  const __m128i high   = _mm_shuffle_epi8(source, _mm_load_si128((const __m128i*) (kPatterns.masks[offset] + 16)));
+  const __m256i pattern     = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+  const unsigned int stride = kPatterns.strides32[offset];
+  do {
+    _mm256_storeu_si256((__m256i*) dst, pattern);
+    dst += stride;
+  } while (dst < end);
+}
+#endif /* MATCH_COPY_X86 */
+
+#ifdef MATCH_COPY_NEON
+static void CopyMatchNeon(unsigned char* dst, unsigned int offset, unsigned int length) {
+  const unsigned char* end = dst + length;
+
+  if (offset >= 16) {
+    do {
+      vst1q_u8(dst, vld1q_u8(dst - offset));
+      dst += 16;
+    } while (dst < end);
+    return;
+  }
+
+  const uint8x16_t pattern  = vqtbl1q_u8(vld1q_u8(dst - offset), vld1q_u8(kPatterns.masks[offset]));
+  const unsigned int stride = kPatterns.strides16[offset];
+  do {
+    vst1q_u8(dst, pattern);
+    dst += stride;
+  } while (dst < end);
+}
+#endif /* MATCH_COPY_NEON */
+
+static MatchCopyKernel SelectKernel() {
+#if defined(MATCH_COPY_X86)
+  if (GetCpuFeatures().avx2)
+    return CopyMatchAvx2;
+  if (GetCpuFeatures().ssse3)
+    return CopyMatchSsse3;
+#elif defined(MATCH_COPY_NEON)
+  if (GetCpuFeatures().neon)
+    return CopyMatchNeon;
+#endif
+  return CopyMatchScalar;
+}
+
+const MatchCopyKernel kMatchCopyKernel = SelectKernel();
@@ -0,0 +1,32 @@
+#ifndef _MATCH_COPY_H
+#define _MATCH_COPY_H
+
+#include <cstring>
+
+/* Bytes a match copy may write past the end of the match; output buffers keep this much room */
+constexpr auto kMatchCopyOverrun = 32;
+
+typedef void (*MatchCopyKernel)(unsigned char*, unsigned int, unsigned int);
+
+/* Widest kernel the CPU supports, selected at startup */
+extern const MatchCopyKernel kMatchCopyKernel;
+
+/**
+ * Copy a match from offset bytes back, repeating the source when it overlaps
+ * the destination. Up to kMatchCopyOverrun bytes past the match may be written.
+ *
+ * @param dst where the match goes; offset bytes before it must be output already
+ * @param offset match distance, at least 1
+ * @param length match length, at least 1
+ */
+inline void CopyMatch(unsigned char* dst, unsigned int offset, unsigned int length) {
+  /* most matches are short and far enough back for two plain 16 byte moves */
+  if (offset >= 16 && length <= 32) {
+    std::memcpy(dst, dst - offset, 16);
+    std::memcpy(dst + 16, dst - offset + 16, 16);
+    return;
+  }
+  kMatchCopyKernel(dst, offset, length);
+}
+
+#endif /* !_MATCH_COPY_H */
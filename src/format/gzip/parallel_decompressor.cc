@@ -0,0 +1,573 @@
+#include "decompressor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "checksum.h"
+
+/* Furthest a match reaches back, and so the history a chunk is decoded without */
+constexpr unsigned int kHistorySize = 32768;
+/* Decoded symbols from this value on stand for byte (symbol - kHistoryMarker) of the unknown history */
+constexpr unsigned int kHistoryMarker = 256;
+constexpr size_t kNoBoundary          = (size_t) -1;
+
+/**
+ * Output of one chunk of the deflate stream: a marked part that may still
+ * refer to the history before the chunk, then plain bytes, once 32 KB in a
+ * row no longer do.
+ */
+struct Chunk {
+  size_t start_bit = 0; /* first block, in bits from the start of the deflate stream */
+  size_t stop_bit  = 0; /* first block of the next chunk, 0 for the last chunk */
+
+  std::unique_ptr<unsigned short[]> marked;
+  size_t marked_size     = 0;
+  size_t marked_capacity = 0;
+
+  unsigned char* plain = nullptr; /* plain_storage, or the output itself for the first chunk */
+  std::unique_ptr<unsigned char[]> plain_storage;
+  unsigned int plain_size     = 0;
+  unsigned int plain_capacity = 0;
+  size_t expected_size        = 0; /* room to make for plain bytes up front, 0 to guess */
+
+  const unsigned char* trailer = nullptr; /* set by the last chunk */
+};
+
+static size_t BitPosition(BitReader* bit_reader, const unsigned char* stream) {
+  return (size_t) (bit_reader->GetInBlock() - stream) * 8 - bit_reader->GetBitCount();
+}
+
+static void SeekBit(BitReader* bit_reader, unsigned char* stream, unsigned char* end, size_t bit) {
+  bit_reader->Init(stream + bit / 8, end);
+  bit_reader->GetBits((int) (bit % 8));
+}
+
+/**
+ * Kraft sum of a set of code lengths
+ *
+ * @return 32768 for a complete code, more when it is over-subscribed
+ */
+static unsigned int KraftSum(const unsigned char* code_length, unsigned int symbols) {
+  unsigned int sum = 0;
+  for (unsigned int i = 0; i < symbols; i++) {
+    if (code_length[i])
+      sum += 32768U >> code_length[i];
+  }
+  return sum;
+}
+
+/**
+ * Check whether a non-final dynamic block could start at a bit offset: the
+ * header has to describe complete code length and literal/length codes, an end
+ * of block code, and an offset code that is not over-subscribed. Encoders write
+ * nothing else, while random bits almost never pass.
+ */
+static bool IsDynamicBlockStart(unsigned char* stream, unsigned char* end, size_t bit) {
+  static const unsigned char code_len_syms[kCodeLenSyms] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+  BitReader bit_reader;
+  SeekBit(&bit_reader, stream, end, bit);
+
+  /* BFINAL 0, BTYPE 2 */
+  if (bit_reader.GetBits(3) != 4)
+    return false;
+
+  unsigned int literal_syms  = bit_reader.GetBits(5);
+  unsigned int offset_syms   = bit_reader.GetBits(5);
+  unsigned int code_len_read = bit_reader.GetBits(4);
+  if (literal_syms > 29 || offset_syms > 29 || code_len_read == -1)
+    return false;
+  literal_syms += 257;
+  offset_syms += 1;
+  code_len_read += 4;
+
+  unsigned char code_len_length[kCodeLenSyms] = {};
+  for (unsigned int i = 0; i < code_len_read; i++) {
+    unsigned int length = bit_reader.GetBits(3);
+    if (length == -1)
+      return false;
+    code_len_length[code_len_syms[i]] = (unsigned char) length;
+  }
+  if (KraftSum(code_len_length, kCodeLenSyms) != 32768)
+    return false;
+
+  /* canonical code length code, looked up 7 bits at a time */
+  unsigned short code_len_table[128];
+  unsigned int next_code = 0;
+  for (unsigned int length = 1; length <= 7; length++) {
+    for (unsigned int symbol = 0; symbol < kCodeLenSyms; symbol++) {
+      if (code_len_length[symbol] != length)
+        continue;
+
+      unsigned int reversed = 0;
+      for (unsigned int i = 0; i < length; i++)
+        reversed |= ((next_code >> i) & 1) << (length - 1 - i);
+      for (unsigned int slot = reversed; slot < 128; slot += 1U << length)
+        code_len_table[slot] = (unsigned short) (symbol | (length << 8));
+      next_code++;
+    }
+    next_code <<= 1;
+  }
+
+  unsigned char code_length[kLiteralSyms + kOffsetSyms];
+  unsigned int i     = 0;
+  unsigned int total = literal_syms + offset_syms;
+  while (i < total) {
+    unsigned int entry = code_len_table[bit_reader.PeekBits() & 127];
+    bit_reader.ConsumeBits((int) (entry >> 8));
+    if (bit_reader.GetAvailableBits() < 0)
+      return false;
+
+    unsigned int symbol = entry & 0xff;
+    if (symbol < 16) {
+      code_length[i++] = (unsigned char) symbol;
+      continue;
+    }
+
+    unsigned int run;
+    unsigned char value = 0;
+    if (symbol == 16) {
+      if (i == 0)
+        return false;
+      run   = bit_reader.GetBits(2) + 3;
+      value = code_length[i - 1];
+    } else if (symbol == 17) {
+      run = bit_reader.GetBits(3) + 3;
+    } else {
+      run = bit_reader.GetBits(7) + 11;
+    }
+    if (run < 3 || i + run > total)
+      return false;
+    while (run--)
+      code_length[i++] = value;
+  }
+
+  return code_length[kEODMarkerSym] && KraftSum(code_length, literal_syms) == 32768 && KraftSum(code_length + literal_syms, offset_syms) <= 32768;
+}
+
+/** Make room for at least room more symbols in the marked part */
+static void ReserveMarked(Chunk* chunk, size_t room) {
+  if (chunk->marked_capacity - chunk->marked_size >= room)
+    return;
+
+  size_t capacity = std::max(chunk->marked_capacity * 2, chunk->marked_size + std::max(room, (size_t) 65536));
+  std::unique_ptr<unsigned short[]> grown(new unsigned short[capacity]);
+  if (chunk->marked_size)
+    std::memcpy(grown.get(), chunk->marked.get(), chunk->marked_size * sizeof(unsigned short));
+  chunk->marked          = std::move(grown);
+  chunk->marked_capacity = capacity;
+}
+
+/**
+ * Decode a huffman block whose history may be unknown. Matches reaching back
+ * before the chunk produce markers for the history bytes they copy.
+ *
+ * @param last_marker set past the last marker written
+ * @param out_size_max size the whole output cannot exceed
+ *
+ * @return 0 for success, -1 for failure
+ */
+static int DecodeMarkedBlock(BitReader* bit_reader, const BlockTables* tables, Chunk* chunk, size_t* last_marker, unsigned int out_size_max) {
+  BitReader reader = *bit_reader; /* local copies stay in registers */
+  size_t size      = chunk->marked_size;
+
+  while (true) {
+    if (size > out_size_max)
+      return -1;
+
+    /* room for the longest match or the literals of one fast entry */
+    if (chunk->marked_capacity - size < 258) {
+      chunk->marked_size = size;
+      ReserveMarked(chunk, 258);
+    }
+    unsigned short* out = chunk->marked.get() + size;
+
+    reader.Refill();
+
+    unsigned int match_length = 0;
+    unsigned int match_offset = 0;
+    if (reader.GetBitCount() >= kFastSymbolBits) {
+      unsigned int entry = tables->literals_decoder.GetFastEntry(reader.PeekRefilled());
+      if ((entry & kEntryKindMask) == kEntryLiterals) {
+        out[0] = (unsigned char) entry;
+        out[1] = (unsigned char) (entry >> 8);
+        out[2] = (unsigned char) (entry >> 16);
+        size += (entry >> 28) & 3;
+        reader.ConsumeBits((entry >> 24) & 15);
+        continue;
+      }
+
+      /* with a full 64-bit shifter the whole match fits the lookahead */
+      if ((entry & kEntryKindMask) == kEntryLength && reader.GetBitCount() >= 48) {
+        reader.ConsumeBits((entry >> 24) & 15);
+        unsigned int extra_bits = (entry >> 16) & 15;
+        match_length            = (entry & 0xffff) + (reader.PeekRefilled() & ((1U << extra_bits) - 1));
+        reader.ConsumeBits(extra_bits);
+
+        unsigned int offset_entry = tables->offset_decoder.GetFastEntry(reader.PeekRefilled());
+        if (offset_entry) {
+          reader.ConsumeBits((offset_entry >> 24) & 15);
+          extra_bits   = (offset_entry >> 20) & 15;
+          match_offset = (offset_entry & 0xffff) + (reader.PeekRefilled() & ((1U << extra_bits) - 1));
+          reader.ConsumeBits(extra_bits);
+        }
+      }
+    }
+
+    if (!match_length) {
+      unsigned int literals_code_word = tables->literals_decoder.ReadValue(tables->literals_rev_sym_table, &reader);
+      if (literals_code_word < 256) {
+        out[0] = (unsigned short) literals_code_word;
+        size++;
+        if (reader.GetAvailableBits() < 0)
+          return -1;
+        continue;
+      }
+      if (literals_code_word == kEODMarkerSym)
+        break;
+      if (literals_code_word == -1 || !(literals_code_word & 0x8000))
+        return -1;
+
+      match_length = reader.GetBits((literals_code_word >> 16) & 15);
+      if (match_length == -1)
+        return -1;
+      match_length += (literals_code_word & 0x7fff);
+    }
+
+    if (!match_offset) {
+      unsigned int offset_code_word = tables->offset_decoder.ReadValue(tables->offset_rev_sym_table, &reader);
+      if (offset_code_word == -1)
+        return -1;
+
+      match_offset = reader.GetBits((offset_code_word >> 16) & 15);
+      if (match_offset == -1)
+        return -1;
+      match_offset += (offset_code_word & 0x7fff);
+    }
+
+    if (match_offset == 0 || match_offset > kHistorySize || reader.GetAvailableBits() < 0)
+      return -1;
+
+    /* markers are tracked per match; a late last_marker only delays the switch to plain bytes */
+    unsigned int values = 0;
+    if (match_offset >= match_length && match_offset <= size) {
+      std::memcpy(out, out - match_offset, match_length * sizeof(unsigned short));
+      for (unsigned int i = 0; i < match_length; i++)
+        values |= out[i];
+    } else if (match_offset <= size) {
+      for (unsigned int i = 0; i < match_length; i++) {
+        out[i] = out[(long long) i - match_offset];
+        values |= out[i];
+      }
+    } else {
+      for (unsigned int i = 0; i < match_length; i++) {
+        long long src = (long long) (size + i) - match_offset;
+        out[i]        = src >= 0 ? chunk->marked[(size_t) src] : (unsigned short) (kHistoryMarker + kHistorySize + src);
+        values |= out[i];
+      }
+    }
+    size += match_length;
+    if (values >= kHistoryMarker)
+      *last_marker = size;
+  }
+
+  *bit_reader        = reader;
+  chunk->marked_size = size;
+  return reader.GetAvailableBits() < 0 ? -1 : 0;
+}
+
+/** Copy a stored block into the marked part */
+static int CopyMarkedStored(BitReader* bit_reader, Chunk* chunk) {
+  if (bit_reader->ByteAllign() < 0 || (bit_reader->GetInBlock() + 4) > bit_reader->GetInBlockEnd())
+    return -1;
+
+  const unsigned char* in         = bit_reader->GetInBlock();
+  unsigned int stored_length      = ((unsigned int) in[0]) | (((unsigned int) in[1]) << 8);
+  unsigned int neg_stored_length  = ((unsigned int) in[2]) | (((unsigned int) in[3]) << 8);
+  if (stored_length != ((~neg_stored_length) & 0xffff) || (in + 4 + stored_length) > bit_reader->GetInBlockEnd())
+    return -1;
+
+  ReserveMarked(chunk, stored_length);
+  std::copy(in + 4, in + 4 + stored_length, chunk->marked.get() + chunk->marked_size);
+  chunk->marked_size += stored_length;
+  bit_reader->ModifyInBlock((int) (4 + stored_length));
+  return 0;
+}
+
+/**
+ * Decode a block into the plain part, growing it until the block fits or
+ * it would exceed the whole output
+ *
+ * @return 0 for success, -1 for failure
+ */
+static int DecodePlainBlock(BitReader* bit_reader, unsigned int block_type, BlockTables* scratch, Chunk* chunk, unsigned int out_size_max) {
+  BitReader block_start = *bit_reader;
+
+  while (true) {
+    unsigned int room   = chunk->plain_capacity - chunk->plain_size;
+    unsigned int result = block_type == 0 ? CopyStored(bit_reader, chunk->plain, chunk->plain_size, room)
+                                          : DecompressBlock(bit_reader, block_type == 2, scratch, chunk->plain, chunk->plain_size, room);
+    if (result != -1) {
+      chunk->plain_size += result;
+      return 0;
+    }
+    if (chunk->plain_capacity >= out_size_max || chunk->plain != chunk->plain_storage.get())
+      return -1;
+
+    unsigned int capacity = chunk->plain_capacity > out_size_max / 2 ? out_size_max : chunk->plain_capacity * 2;
+    std::unique_ptr<unsigned char[]> grown(new unsigned char[capacity]);
+    std::memcpy(grown.get(), chunk->plain, chunk->plain_size);
+    chunk->plain_storage  = std::move(grown);
+    chunk->plain          = chunk->plain_storage.get();
+    chunk->plain_capacity = capacity;
+    *bit_reader           = block_start;
+  }
+}
+
+/**
+ * Decode the blocks of a chunk, up to the first block of the next one
+ *
+ * @param known_history whether the chunk starts the stream, so matches cannot reach before it
+ * @param max_blocks number of blocks to decode at most, 0 for no limit
+ *
+ * @return 0 for success, -1 when the data is corrupt or the chunk does not end at stop_bit
+ */
+static int DecodeChunk(unsigned char* stream, unsigned char* end, Chunk* chunk, unsigned int out_size_max, bool known_history, int max_blocks) {
+  BitReader bit_reader;
+  std::unique_ptr<BlockTables> scratch(new BlockTables);
+  size_t last_marker = 0;
+  bool plain         = false;
+
+  SeekBit(&bit_reader, stream, end, chunk->start_bit);
+
+  /* typical tarballs inflate to 4 or 5 times their size */
+  size_t compressed = ((chunk->stop_bit ? chunk->stop_bit : (size_t) (end - stream) * 8) - chunk->start_bit) / 8;
+  size_t capacity   = chunk->expected_size ? chunk->expected_size : compressed * 4 + kHistorySize * 2;
+
+  if (!chunk->plain)
+    chunk->plain_capacity = (unsigned int) std::min((size_t) out_size_max, capacity);
+  if (known_history) {
+    if (!chunk->plain) {
+      chunk->plain_storage.reset(new unsigned char[chunk->plain_capacity]);
+      chunk->plain = chunk->plain_storage.get();
+    }
+    plain = true;
+  }
+
+  for (int blocks = 0; !max_blocks || blocks < max_blocks; blocks++) {
+    size_t position = BitPosition(&bit_reader, stream);
+    if (chunk->stop_bit && position >= chunk->stop_bit)
+      return position == chunk->stop_bit ? 0 : -1;
+
+    unsigned int final_block = bit_reader.GetBits(1);
+    unsigned int block_type  = bit_reader.GetBits(2);
+    if (final_block == -1 || block_type == -1 || block_type == 3 || (final_block && chunk->stop_bit))
+      return -1;
+
+    if (plain) {
+      if (DecodePlainBlock(&bit_reader, block_type, scratch.get(), chunk, out_size_max) < 0)
+        return -1;
+    } else {
+      if (block_type == 0) {
+        if (CopyMarkedStored(&bit_reader, chunk) < 0)
+          return -1;
+      } else {
+        const BlockTables* tables = PrepareBlock(&bit_reader, block_type == 2, scratch.get());
+        if (!tables || DecodeMarkedBlock(&bit_reader, tables, chunk, &last_marker, out_size_max) < 0)
+          return -1;
+      }
+
+      /* 32 KB without markers: no match can reach the unknown history any more */
+      if (chunk->marked_size - last_marker >= kHistorySize && chunk->plain_capacity >= kHistorySize) {
+        chunk->plain_storage.reset(new unsigned char[chunk->plain_capacity]);
+        chunk->plain = chunk->plain_storage.get();
+        for (unsigned int i = 0; i < kHistorySize; i++)
+          chunk->plain[i] = (unsigned char) chunk->marked[chunk->marked_size - kHistorySize + i];
+        chunk->marked_size -= kHistorySize;
+        chunk->plain_size = kHistorySize;
+        plain             = true;
+      }
+    }
+
+    if (chunk->marked_size + chunk->plain_size > out_size_max)
+      return -1;
+
+    if (final_block) {
+      bit_reader.ByteAllign();
+      chunk->trailer = bit_reader.GetInBlock();
+      return 0;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * Find the first block in a range of the stream that is plausible and decodes
+ *
+ * @return its bit offset, or kNoBoundary
+ */
+static size_t FindBoundary(unsigned char* stream, unsigned char* end, size_t from_bit, size_t to_bit, unsigned int out_size_max) {
+  for (size_t bit = from_bit; bit < to_bit; bit++) {
+    if (!IsDynamicBlockStart(stream, end, bit))
+      continue;
+
+    Chunk trial;
+    trial.start_bit     = bit;
+    trial.expected_size = kHistorySize * 4;
+    if (DecodeChunk(stream, end, &trial, out_size_max, false, 1) == 0)
+      return bit;
+  }
+  return kNoBoundary;
+}
+
+/**
+ * Write the symbols of the marked part of a chunk in [from, to) to the output,
+ * markers replaced by the history bytes they stand for
+ *
+ * @return false when a marker reaches before the start of the output
+ */
+static bool ResolveMarkers(const Chunk& chunk, unsigned char* chunk_out, size_t chunk_offset, size_t from, size_t to) {
+  if (from >= to)
+    return true;
+
+  if (chunk_offset < kHistorySize) {
+    for (size_t k = from; k < to; k++) {
+      if (chunk.marked[k] >= kHistoryMarker && chunk.marked[k] < kHistoryMarker + kHistorySize - chunk_offset)
+        return false;
+    }
+  }
+
+  /* literals map to themselves, markers into the history, so every symbol is one lookup */
+  std::unique_ptr<unsigned char[]> lookup(new unsigned char[kHistoryMarker + kHistorySize]);
+  for (unsigned int i = 0; i < kHistoryMarker; i++)
+    lookup[i] = (unsigned char) i;
+  size_t history = std::min(chunk_offset, (size_t) kHistorySize);
+  std::memcpy(lookup.get() + kHistoryMarker + kHistorySize - history, chunk_out - history, history);
+
+  for (size_t k = from; k < to; k++)
+    chunk_out[k] = lookup[chunk.marked[k]];
+  return true;
+}
+
+/** Run task(0) .. task(count - 1) on up to threads threads, each taking the next index when done */
+template<class Task>
+static void RunParallel(size_t count, unsigned int threads, const Task& task) {
+  std::atomic<size_t> next(0);
+  auto worker = [&]() {
+    for (size_t i = next++; i < count; i = next++)
+      task(i);
+  };
+
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < std::min((size_t) threads, count); i++)
+    workers.emplace_back(worker);
+  worker();
+  for (auto& thread : workers)
+    thread.join();
+}
+
+/**
+ * Inflate a large gzip member on several threads. The deflate stream is split
+ * at block boundaries found by trial decoding; every chunk but the first is
+ * decoded without its history, leaving markers where matches reach back into
+ * it, and the markers are resolved once the 32 KB before each chunk are
+ * known. Small inputs, other formats, and streams whose boundaries cannot be
+ * confirmed take the serial path; either way the output is the same.
+ *
+ * @param compressed_data pointer to start of gzip data
+ * @param compressed_data_size size of gzip data, in bytes
+ * @param out pointer to start of decompression buffer
+ * @param out_size_max maximum size of decompression buffer, in bytes
+ * @param checksum whether to verify the trailer; the parallel path always does
+ * @param threads number of threads to use
+ * @param chunk_size fewest compressed bytes worth a chunk of their own
+ *
+ * @return number of bytes decompressed, or -1 in case of an error
+ */
+unsigned int Decompressor::FeedParallel(const void* compressed_data, unsigned int compressed_data_size, unsigned char* out, unsigned int out_size_max, bool checksum, unsigned int threads, unsigned int chunk_size) {
+  auto* data = (unsigned char*) compressed_data;
+  auto* end  = data + compressed_data_size;
+  int trailer_format;
+
+  unsigned char* stream = ReadStreamHeader(data, end, &trailer_format);
+  size_t stream_size    = stream ? (size_t) (end - stream) : 0;
+  size_t chunks         = std::min((size_t) threads * 4, stream_size / std::max(chunk_size, 1U));
+  if (!stream || trailer_format != 1 || threads < 2 || chunks < 2)
+    return Feed(compressed_data, compressed_data_size, out, out_size_max, checksum);
+
+  try {
+    /* one boundary per stride, except where none is found */
+    size_t stride = stream_size / chunks;
+    std::vector<size_t> boundaries(chunks, 0);
+    RunParallel(chunks - 1, threads, [&](size_t i) {
+      boundaries[i + 1] = FindBoundary(stream, end, (i + 1) * stride * 8, (i + 2) * stride * 8, out_size_max);
+    });
+
+    std::vector<Chunk> parts;
+    for (size_t boundary : boundaries) {
+      if (boundary == kNoBoundary)
+        continue;
+      if (!parts.empty())
+        parts.back().stop_bit = boundary;
+      parts.emplace_back();
+      parts.back().start_bit = boundary;
+    }
+    if (parts.size() < 2)
+      return Feed(compressed_data, compressed_data_size, out, out_size_max, checksum);
+
+    /* the first chunk has its history and goes straight to the output, the others size their buffers from the overall ratio */
+    parts[0].plain          = out;
+    parts[0].plain_capacity = out_size_max;
+    for (auto& part : parts) {
+      size_t compressed  = ((part.stop_bit ? part.stop_bit : stream_size * 8) - part.start_bit) / 8;
+      part.expected_size = (size_t) ((double) out_size_max / stream_size * compressed * 1.125) + kHistorySize;
+    }
+
+    std::vector<char> decoded(parts.size(), 0);
+    RunParallel(parts.size(), threads, [&](size_t i) {
+      decoded[i] = DecodeChunk(stream, end, &parts[i], out_size_max, i == 0, 0) == 0;
+    });
+
+    std::vector<size_t> offsets(parts.size() + 1, 0);
+    bool usable = true;
+    for (size_t i = 0; i < parts.size(); i++) {
+      usable &= decoded[i] != 0;
+      offsets[i + 1] = offsets[i] + parts[i].marked_size + parts[i].plain_size;
+    }
+
+    if (usable && offsets.back() <= out_size_max) {
+      RunParallel(parts.size(), threads, [&](size_t i) {
+        unsigned char* plain_out = out + offsets[i] + parts[i].marked_size;
+        if (parts[i].plain_size && parts[i].plain != plain_out)
+          std::memcpy(plain_out, parts[i].plain, parts[i].plain_size);
+      });
+
+      /* markers only read the 32 KB before their chunk: finish those tails front to back, the rest in parallel */
+      std::vector<size_t> tails(parts.size());
+      for (size_t i = 0; i < parts.size(); i++) {
+        size_t window = offsets[i + 1] - std::min(offsets[i + 1], (size_t) kHistorySize);
+        tails[i]      = i + 1 < parts.size() ? std::min(parts[i].marked_size, window - std::min(window, offsets[i])) : parts[i].marked_size;
+        usable &= ResolveMarkers(parts[i], out + offsets[i], offsets[i], tails[i], parts[i].marked_size);
+      }
+
+      std::vector<char> resolved(parts.size(), 0);
+      RunParallel(parts.size(), threads, [&](size_t i) {
+        resolved[i] = ResolveMarkers(parts[i], out + offsets[i], offsets[i], 0, tails[i]);
+      });
+      for (char chunk_resolved : resolved)
+        usable &= chunk_resolved != 0;
+
+      unsigned int size = (unsigned int) offsets.back();
+      if (usable && CheckTrailer(parts.back().trailer, end, trailer_format, Crc32(0, out, size), size) == 0)
+        return size;
+    }
+  } catch (const std::system_error&) {
+    /* no threads to be had */
+  }
+
+  return Feed(compressed_data, compressed_data_size, out, out_size_max, checksum);
+}
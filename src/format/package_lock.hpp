@@ -92,6 +92,7 @@ namespace packagelock {
       return Dependency{
           .path         = newRoot,
           .resolved     = parseValue(value, "resolved", ""),
+          .integrity    = parseValue(value, "integrity", ""),
           .dev          = parseValue(value, "dev", "false") == "true",
           .optional     = parseValue(value, "optional", "false") == "true",
           .dependencies = parseDependencies(newRoot + NM, value),
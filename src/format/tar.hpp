@@ -1,68 +1,523 @@
 #include "../headers/tar_header.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
 #include <string>
+#include <string_view>
 #include <vector>
+#if defined(__SSE2__) || defined(_M_X64)
+#  define TAR_SSE2
+#  include <emmintrin.h>
+#elif defined(__aarch64__)
+#  define TAR_NEON
+#  include <arm_neon.h>
+#endif
 
 namespace tar {
 #define HEADER_SIZE 512
 #define PADDING_SIZE 512
-#define ASCII_TO_NUMBER(num) ((num) -48)
+
+  /** How an entry is handled, by its type flag */
+  enum class Kind { File,
+    LongName,
+    Extended,
+    Skip };
+
+  /** Path and size for the next entry, from a PAX extended header or GNU long name before it */
+  struct Overrides {
+    std::string_view path;
+    uint64_t size = 0;
+    bool hasSize  = false;
+  };
 
   namespace {
-    auto decodeString(const char* in, size_t len) -> std::string {
-      std::string a;
-      for (int j = 0; j < len; j++) {
-        if (in[j] == 0) {
-          break;
+    /** @return name in a fixed size field, up to its first NUL */
+    auto decodeName(const char* in, size_t len) -> std::string_view {
+      const void* end = std::memchr(in, 0, len);
+      return std::string_view(in, end ? static_cast<const char*>(end) - in : len);
+    }
+
+    /** @return name with prefix taken off its front, when it starts with it */
+    auto stripPrefix(std::string_view name, std::string_view prefix) -> std::string_view {
+      if (!prefix.empty() && name.substr(0, prefix.size()) == prefix) name.remove_prefix(prefix.size());
+      return name;
+    }
+
+    /** @return whether the 8 bytes of word are all octal digits, '0' to '7' */
+    auto allOctal(uint64_t word) -> bool {
+      return (word & 0xf8f8f8f8f8f8f8f8ULL) == 0x3030303030303030ULL;
+    }
+
+    /**
+     * Numeric header field: octal digits after optional spaces, ended by NUL,
+     * space or the end of the field, or base-256 (leading byte 0x80) for values
+     * octal cannot hold, like sizes over 8 GB. Eight digits at a time are
+     * combined within one 64 bit word.
+     *
+     * @param value the number, untouched if the field is not one
+     * @return false if the field holds anything else
+     */
+    auto decodeNumber(const char* data, size_t size, uint64_t& value) -> bool {
+      const auto* field = reinterpret_cast<const unsigned char*>(data);
+      if (field[0] & 0x80) {
+        if (field[0] != 0x80 || size < 2) return false;  // negative, or too large for 63 bits
+        uint64_t number = 0;
+        for (size_t i = 1; i < size; i++) {
+          if (number >> 56) return false;
+          number = (number << 8) | field[i];
         }
-        a += in[j];
+        value = number;
+        return true;
       }
 
-      return a;
-    }
+      size_t i = 0;
+      while (i < size && field[i] == ' ') i++;
 
-    auto decodeOctal(char* data, size_t size = 12) -> uint64_t {
-      unsigned char* currentPtr  = reinterpret_cast<unsigned char*>(data) + size;
-      uint64_t sum               = 0;
-      uint64_t currentMultiplier = 1;
-      unsigned char* checkPtr    = currentPtr;
-      for (; checkPtr >= reinterpret_cast<unsigned char*>(data); checkPtr--) {
-        if ((*checkPtr) == 0 || (*checkPtr) == ' ') {
-          currentPtr = checkPtr - 1;
+      uint64_t number = 0;
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+      if (size - i >= 8) {
+        uint64_t word;
+        std::memcpy(&word, field + i, 8);
+        if (allOctal(word)) {
+          // little-endian: the first digit is the lowest byte and the most significant
+          word -= 0x3030303030303030ULL;
+          word   = ((word & 0x00ff00ff00ff00ffULL) << 3) + ((word >> 8) & 0x00ff00ff00ff00ffULL);
+          word   = ((word & 0x0000ffff0000ffffULL) << 6) + ((word >> 16) & 0x0000ffff0000ffffULL);
+          number = ((word & 0xffffffffULL) << 12) + (word >> 32);
+          i += 8;
         }
       }
-      for (; currentPtr >= reinterpret_cast<unsigned char*>(data); currentPtr--) {
-        sum += ASCII_TO_NUMBER(*currentPtr) * currentMultiplier;
-        currentMultiplier *= 8;
+#endif
+      for (; i < size && field[i] >= '0' && field[i] <= '7'; i++) {
+        if (number >> 60) return false;
+        number = number * 8 + (field[i] - '0');
+      }
+      for (; i < size; i++) {
+        if (field[i] != 0 && field[i] != ' ') return false;
+      }
+
+      value = number;
+      return true;
+    }
+
+    /** @return sum of the bytes of a header block, as unsigned values */
+    auto sumBlock(const unsigned char* block) -> unsigned int {
+#if defined(TAR_SSE2)
+      const __m128i zero = _mm_setzero_si128();
+      __m128i sum        = zero;
+      for (int i = 0; i < HEADER_SIZE; i += 64) {
+        __m128i a = _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i)), zero);
+        __m128i b = _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i + 16)), zero);
+        __m128i c = _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i + 32)), zero);
+        __m128i d = _mm_sad_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i + 48)), zero);
+        sum       = _mm_add_epi64(sum, _mm_add_epi64(_mm_add_epi64(a, b), _mm_add_epi64(c, d)));
       }
+      return (unsigned int) (_mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(sum, sum)));
+#elif defined(TAR_NEON)
+      uint32x4_t sum = vdupq_n_u32(0);
+      for (int i = 0; i < HEADER_SIZE; i += 32) {
+        uint16x8_t pairs = vaddq_u16(vpaddlq_u8(vld1q_u8(block + i)), vpaddlq_u8(vld1q_u8(block + i + 16)));
+        sum              = vpadalq_u16(sum, pairs);
+      }
+      return vaddvq_u32(sum);
+#else
+      unsigned int sum = 0;
+      for (int i = 0; i < HEADER_SIZE; i++) sum += block[i];
       return sum;
+#endif
+    }
+
+    /** Numbers of a header block that extraction needs */
+    struct Fields {
+      uint64_t size;
+      unsigned int mode;
+    };
+
+    /**
+     * Check the header checksum, which sums the block with its own field read
+     * as spaces, and decode the size and mode. Checksums of old archivers that
+     * summed signed bytes are accepted as well.
+     *
+     * @return false if the block is not a valid header
+     */
+    auto decodeHeader(const unsigned char* block, Fields& fields) -> bool {
+      const auto* header = reinterpret_cast<const Header*>(block);
+      uint64_t checksum, mode;
+      if (!decodeNumber(header->checksum, sizeof(header->checksum), checksum)) return false;
+
+      const size_t from        = offsetof(Header, checksum);
+      const size_t to          = from + sizeof(header->checksum);
+      unsigned int unsignedSum = sumBlock(block) + 8 * ' ';
+      for (size_t i = from; i < to; i++) {
+        unsignedSum -= block[i];
+      }
+      if (checksum != unsignedSum) {
+        int signedSum = 8 * ' ';
+        for (size_t i = 0; i < HEADER_SIZE; i++) {
+          if (i < from || i >= to) signedSum += (signed char) block[i];
+        }
+        if ((int64_t) checksum != signedSum) return false;
+      }
+
+      if (!decodeNumber(header->fileSize, sizeof(header->fileSize), fields.size)) return false;
+      if (!decodeNumber(header->mode, sizeof(header->mode), mode)) return false;
+      fields.mode = (unsigned int) (mode & 07777);
+      return true;
+    }
+
+    auto kindOf(char typeFlag) -> Kind {
+      switch (typeFlag) {
+        case '0':
+        case '\0':
+        case '7':
+          return Kind::File;
+        case 'L':
+          return Kind::LongName;
+        case 'x':
+          return Kind::Extended;
+        default:  // directories, links, devices, FIFOs, global PAX headers and other extensions
+          return Kind::Skip;
+      }
+    }
+
+    /**
+     * Take the path and size records of a PAX extended header body, each
+     * "<length> <key>=<value>\n"; other keys are of no use here and skipped
+     *
+     * @param next views into records for what was found
+     * @return false if a record is malformed
+     */
+    auto parsePax(std::string_view records, Overrides& next) -> bool {
+      while (!records.empty() && records[0] != '\0') {
+        size_t length = 0, i = 0;
+        for (; i < records.size() && records[i] >= '0' && records[i] <= '9'; i++) {
+          length = length * 10 + (records[i] - '0');
+          if (length > records.size()) return false;
+        }
+        if (i == 0 || length < i + 3 || records[i] != ' ' || records[length - 1] != '\n') return false;
+
+        std::string_view record = records.substr(i + 1, length - i - 2);
+        records.remove_prefix(length);
+        size_t equals = record.find('=');
+        if (equals == std::string_view::npos) return false;
+
+        std::string_view key   = record.substr(0, equals);
+        std::string_view value = record.substr(equals + 1);
+        if (key == "path") {
+          next.path = value;
+        } else if (key == "size") {
+          uint64_t number = 0;
+          for (char digit : value) {
+            if (digit < '0' || digit > '9' || number > (UINT64_MAX - 9) / 10) return false;
+            number = number * 10 + (digit - '0');
+          }
+          if (value.empty()) return false;
+          next.size    = number;
+          next.hasSize = true;
+        }
+      }
+      return true;
+    }
+
+    /** Path of a file entry, in two parts when a ustar prefix field holds its directory */
+    struct Path {
+      std::string_view directory;
+      std::string_view name;
+    };
+
+    /**
+     * @param longName path recorded by a PAX header or GNU long name, empty if none
+     * @param prefix taken off the front of the path
+     * @return path of a file entry; an empty name, or one ending in a slash, is no file to write
+     */
+    auto entryPath(const Header* header, std::string_view longName, std::string_view prefix) -> Path {
+      Path path{{}, longName};
+      if (longName.empty()) {
+        path.name = decodeName(header->fileName, sizeof(header->fileName));
+        if (std::memcmp(header->ustarIndicator, "ustar", 5) == 0) {
+          path.directory = decodeName(header->filenamePrefix, sizeof(header->filenamePrefix));
+        }
+      }
+
+      if (path.directory.empty()) {
+        path.name = stripPrefix(path.name, prefix);
+      } else if (prefix.size() == path.directory.size() + 1 && prefix.back() == '/' && prefix.substr(0, path.directory.size()) == path.directory) {
+        path.directory = {};
+      } else {
+        path.directory = stripPrefix(path.directory, prefix);
+      }
+      return path;
+    }
+
+    auto isFile(const Path& path) -> bool {
+      return !path.name.empty() && path.name.back() != '/';
+    }
+
+    /** @return whether a path has a ".." component */
+    auto climbs(std::string_view path) -> bool {
+      for (;;) {
+        size_t slash = path.find('/');
+        if (path.substr(0, slash) == "..") return true;
+        if (slash == std::string_view::npos) return false;
+        path.remove_prefix(slash + 1);
+      }
+    }
+
+    /**
+     * Names from PAX headers and GNU long names are as arbitrary as any other;
+     * none may write outside the directory the archive is extracted to
+     *
+     * @return whether path is relative and never climbs above where it starts
+     */
+    auto isContained(const Path& path) -> bool {
+      std::string_view first = path.directory.empty() ? path.name : path.directory;
+      return first.substr(0, 1) != "/" && !climbs(path.directory) && !climbs(path.name);
     }
   }  // namespace
 
-  using Content = std::vector<std::pair<std::string, std::string>>;
+  /** File of an archive, viewing into the buffer the archive was read from */
+  struct Entry {
+    std::string_view directory;  // from the ustar prefix field, usually empty
+    std::string_view name;
+    std::string_view body;
+    unsigned int mode;
 
-  auto read(unsigned char* file, const std::string& prefix) -> Content {
+    [[nodiscard]] auto path() const -> std::string {
+      if (this->directory.empty()) return std::string(this->name);
+      std::string joined(this->directory);
+      joined += '/';
+      joined += this->name;
+      return joined;
+    }
+  };
+
+  using Content = std::vector<Entry>;
+
+  /**
+   * Entries of an archive held in memory, without copying names or bodies.
+   * Long names from PAX headers and GNU 'L' entries, ustar prefixes and PAX
+   * sizes are applied as the entries go by; directories, links and other
+   * entries that are not regular files are skipped, and so are files whose
+   * path is absolute or has a ".." component. Paths are stripped of prefix.
+   *
+   * @param size archive length; an entry running past it, or a header that
+   * fails its checksum, ends the archive
+   * @return entries, valid as long as file is
+   */
+  auto read(const unsigned char* file, size_t size, std::string_view prefix) -> Content {
     Content tc;
+    Overrides next;
 
-    unsigned int i = 0;
-    for (;;) {
-      auto* header          = reinterpret_cast<Header*>(&file[i]);
-      unsigned int fileSize = decodeOctal(header->fileSize, 12);
-      std::string fileName  = decodeString(header->fileName, 100);
+    for (size_t i = 0; size - i >= HEADER_SIZE;) {
+      const auto* header = reinterpret_cast<const Header*>(&file[i]);
+      if (header->fileName[0] == 0) {
+        break;
+      }
 
-      if (!prefix.empty() && fileName.find(prefix) == 0) {  // NOLINT(abseil-string-find-startswith)
-        fileName = fileName.substr(prefix.length());
+      Fields fields{};
+      if (!decodeHeader(&file[i], fields)) {
+        break;
       }
 
-      if (fileName.empty()) {
+      Kind kind         = kindOf(header->typeFlag);
+      uint64_t fileSize = kind == Kind::File && next.hasSize ? next.size : fields.size;
+      if (fileSize > size - i - HEADER_SIZE) {
         break;
       }
-      std::string fileContent = decodeString(&header->firstContent, fileSize);
-      tc.emplace_back(std::pair<std::string, std::string>(fileName, fileContent));
 
-      unsigned int contentSize = (fileSize % PADDING_SIZE == 0) ? fileSize : ((fileSize / PADDING_SIZE) + 1) * PADDING_SIZE;
+      std::string_view body(reinterpret_cast<const char*>(&file[i + HEADER_SIZE]), fileSize);
+      if (kind == Kind::LongName) {
+        next.path = decodeName(body.data(), body.size());
+      } else if (kind == Kind::Extended) {
+        if (!parsePax(body, next)) {
+          break;
+        }
+      } else {
+        Path path = entryPath(header, next.path, prefix);
+        if (kind == Kind::File && isFile(path) && isContained(path)) {
+          tc.push_back(Entry{path.directory, path.name, body, fields.mode});
+        }
+        next = Overrides{};
+      }
+
+      uint64_t contentSize = (fileSize + PADDING_SIZE - 1) / PADDING_SIZE * PADDING_SIZE;
+      if (contentSize > size - i - HEADER_SIZE) {
+        break;
+      }
       i += HEADER_SIZE + contentSize;
     }
 
     return tc;
   }
+
+  /**
+   * Incremental archive reader. The archive is fed in chunks of any size as it
+   * is inflated; headers may be split across chunks and are gathered in a
+   * block of their own, bodies are handed on as slices of the fed chunks. Each
+   * file is reported as onEntry with its full path, any number of onData
+   * calls, then onEntryEnd. Names resolve like in tar::read; the bodies of
+   * long name and PAX entries are gathered in the reader, since the names they
+   * carry outlive the chunk. A header failing its checksum stops the reader
+   * for good.
+   */
+  class Reader {
+  public:
+    struct Handler {
+      std::function<void(std::string_view, uint64_t, unsigned int)> onEntry;
+      std::function<void(const char*, size_t)> onData;
+      std::function<void()> onEntryEnd;
+    };
+
+    Reader(std::string prefix, Handler handler)
+        : _prefix(std::move(prefix)), _handler(std::move(handler)) {}
+
+    /** @param data next bytes of the archive; anything after the end of archive block is ignored */
+    void Feed(const unsigned char* data, size_t size) {
+      while (size && this->_state != State::End && this->_state != State::Error) {
+        size_t used = 0;
+        switch (this->_state) {
+          case State::Header:
+            used = this->ReadHeader(data, size);
+            break;
+          case State::Body:
+            used = (size_t) std::min((uint64_t) size, this->_remaining);
+            if (this->_kind == Kind::LongName || this->_kind == Kind::Extended) {
+              this->_meta.append(reinterpret_cast<const char*>(data), used);
+            } else if (this->_emit) {
+              this->_handler.onData(reinterpret_cast<const char*>(data), used);
+            }
+            this->_remaining -= used;
+            if (this->_remaining == 0) this->EndEntry();
+            break;
+          case State::Padding:
+            used = (size_t) std::min((uint64_t) size, this->_remaining);
+            this->_remaining -= used;
+            if (this->_remaining == 0) this->_state = State::Header;
+            break;
+          case State::End:
+          case State::Error:
+            break;
+        }
+        data += used;
+        size -= used;
+      }
+    }
+
+    /** @return whether the end of archive block was read */
+    [[nodiscard]] auto Done() const noexcept -> bool {
+      return this->_state == State::End;
+    }
+
+    /** @return whether a corrupt header stopped the reader */
+    [[nodiscard]] auto Failed() const noexcept -> bool {
+      return this->_state == State::Error;
+    }
+
+  private:
+    enum class State { Header,
+      Body,
+      Padding,
+      End,
+      Error };
+
+    /** @return bytes of data used for the header, which is parsed once all 512 are in */
+    auto ReadHeader(const unsigned char* data, size_t size) -> size_t {
+      const unsigned char* block = data;
+      size_t used                = HEADER_SIZE;
+      if (this->_have || size < HEADER_SIZE) {
+        used = std::min(size, (size_t) HEADER_SIZE - this->_have);
+        std::memcpy(this->_block + this->_have, data, used);
+        this->_have += used;
+        if (this->_have < HEADER_SIZE) return used;
+        this->_have = 0;
+        block       = this->_block;
+      }
+
+      auto* header = reinterpret_cast<const Header*>(block);
+      if (header->fileName[0] == 0) {
+        this->_state = State::End;
+        return used;
+      }
+
+      Fields fields{};
+      if (!decodeHeader(block, fields)) {
+        this->_state = State::Error;
+        return used;
+      }
+
+      this->_kind      = kindOf(header->typeFlag);
+      this->_remaining = this->_kind == Kind::File && this->_next.hasSize ? this->_next.size : fields.size;
+      this->_padding   = (PADDING_SIZE - this->_remaining % PADDING_SIZE) % PADDING_SIZE;
+      this->_emit      = false;
+
+      if (this->_kind == Kind::LongName || this->_kind == Kind::Extended) {
+        if (this->_remaining > kMaxMetaSize) {
+          this->_state = State::Error;
+          return used;
+        }
+        this->_meta.clear();
+      } else {
+        Path path = entryPath(header, this->_next.path, this->_prefix);
+        if (this->_kind == Kind::File && isFile(path) && isContained(path)) {
+          this->_path.assign(path.directory);
+          if (!path.directory.empty()) this->_path += '/';
+          this->_path.append(path.name);
+          this->_emit = true;
+          this->_handler.onEntry(this->_path, this->_remaining, fields.mode);
+        }
+        this->_next = Overrides{};
+      }
+
+      if (this->_remaining == 0) {
+        this->EndEntry();
+      } else {
+        this->_state = State::Body;
+      }
+      return used;
+    }
+
+    void EndEntry() {
+      if (this->_emit) this->_handler.onEntryEnd();
+      this->_remaining = this->_padding;
+      this->_state     = this->_padding ? State::Padding : State::Header;
+
+      if (this->_kind == Kind::LongName) {
+        this->_longName.assign(decodeName(this->_meta.data(), this->_meta.size()));
+        this->_next.path = this->_longName;
+      } else if (this->_kind == Kind::Extended) {
+        Overrides records;
+        if (!parsePax(this->_meta, records)) {
+          this->_state = State::Error;
+          return;
+        }
+        if (!records.path.empty()) {
+          this->_longName.assign(records.path);
+          this->_next.path = this->_longName;
+        }
+        if (records.hasSize) {
+          this->_next.size    = records.size;
+          this->_next.hasSize = true;
+        }
+      }
+    }
+
+    /* larger long name or PAX bodies come from a corrupt archive */
+    static constexpr uint64_t kMaxMetaSize = 1 << 20;
+
+    std::string _prefix;
+    Handler _handler;
+    State _state         = State::Header;
+    uint64_t _remaining  = 0;  // body or padding bytes still to come
+    uint64_t _padding    = 0;
+    bool _emit           = false;
+    Kind _kind           = Kind::Skip;
+    Overrides _next;
+    std::string _meta;      // body of the long name or PAX entry being read
+    std::string _longName;  // path of the next entry, when _next has one
+    std::string _path;
+    unsigned char _block[HEADER_SIZE]{};
+    size_t _have = 0;
+  };
 }  // namespace tar
@@ -7,6 +7,7 @@
 struct Dependency {
   std::string path;
   std::string resolved;
+  std::string integrity;
   bool dev{true};
   bool optional{true};
   std::vector<Dependency> dependencies{};
@@ -1,11 +1,19 @@
+#include <cstdio>
+#include <cstdlib>
 #include <fstream>
+#include <thread>
 #include <vector>
 
 #include "format/gzip/decompressor.h"
+#include "format/gzip/inflater.h"
 #include "format/package_lock.hpp"
 #include "format/tar.hpp"
+#include "proto/event_loop.hpp"
 #include "proto/http.hpp"
 #include "util/args.hpp"
+#include "util/buffer_pool.hpp"
+#include "util/cache.hpp"
+#include "util/integrity.hpp"
 #include "util/fs.hpp"
 #include "util/regex.h"
 #include "util/thread_pool.hpp"
@@ -31,54 +39,247 @@ auto process(Dependencies& v, bool include_dev = false, bool include_opt = false
   return dep;
 }
 
-void create_fs(const std::string& prefix, const regex::List& list, const tar::Content& files) noexcept {
+/** @return where an archive entry goes under prefix, empty when the ignore list leaves it out */
+auto destination(const std::string& prefix, const regex::List& list, std::string_view name) -> std::string {
+  std::string file(name);
+  if (regex::test(file, list)) return "";
+  return "." + prefix + "/" + file;
+}
+
+/** Write the entries of an inflated archive under prefix, each body in a single write */
+void create_fs(fs::Directories& directories, const std::string& prefix, const regex::List& list, const tar::Content& files) noexcept {
   for (const auto& i : files) {
-    if (!regex::test(i.first, list)) {
-      std::string path = "." + prefix + "/" + i.first;
+    std::string path = destination(prefix, list, i.path());
+    if (path.empty()) continue;
+
+    directories.Create(path, false);
+    fs::write_file(path, i.body.data(), i.body.size());
+    if (i.mode & 0111) fs::set_executable(path);
+  }
+}
+
+/** Files a streaming extraction has written, and the first write that failed */
+struct Extraction {
+  std::FILE* out = nullptr;
+  std::vector<std::string> written;
+  std::string error;
+
+  void Fail(const std::string& path) {
+    if (this->error.empty()) this->error = "Unable to write '" + path + "'";
+  }
+
+  /** Remove everything written, so a package is either complete or not there at all */
+  void Undo() {
+    if (this->out) std::fclose(this->out);
+    this->out = nullptr;
+    for (const auto& path : this->written) std::remove(path.c_str());
+    this->written.clear();
+  }
+};
+
+/** Handler writing each entry under prefix as the streaming tar reader emits it */
+auto create_fs(fs::Directories& directories, const std::string& prefix, const regex::List& list, Extraction& extraction) -> tar::Reader::Handler {
+  return tar::Reader::Handler{
+      .onEntry    = [&directories, &prefix, &list, &extraction](std::string_view name, uint64_t, unsigned int mode) {
+        std::string path = destination(prefix, list, name);
+        if (path.empty()) return;
+        directories.Create(path, false);
+        extraction.out = std::fopen(path.c_str(), "wb");
+        if (!extraction.out) return extraction.Fail(path);
+        extraction.written.emplace_back(std::move(path));
+        if (mode & 0111) fs::set_executable(extraction.written.back());
+      },
+      .onData     = [&extraction](const char* data, size_t size) {
+        if (extraction.out && std::fwrite(data, 1, size, extraction.out) != size) {
+          std::fclose(extraction.out);
+          extraction.out = nullptr;
+          extraction.Fail(extraction.written.back());
+        }
+      },
+      .onEntryEnd = [&extraction]() {
+        if (extraction.out && std::fclose(extraction.out) != 0) extraction.Fail(extraction.written.back());
+        extraction.out = nullptr;
+      }};
+}
+
+/** @return the gzip ISIZE trailer of a tarball, 0 when it cannot be trusted to size the archive */
+auto trusted_size(const std::vector<char>& content) -> unsigned int {
+  unsigned int isize = Decompressor::InflatedSize(content.data(), content.size());
 
-      fs::create_dir(path, false);
+  // deflate cannot expand data more than ~1032:1, larger claims come from a wrapped or corrupt trailer
+  if (isize == -1 || isize / 1032 > content.size()) return 0;
+  return isize;
+}
+
+/**
+ * Threads one tarball may inflate on. Every pool worker inflates a package of
+ * its own already, so a few extra threads let the rare huge tarball finish
+ * sooner without multiplying workers by cores when several arrive together.
+ */
+constexpr unsigned int kInflateThreads = 4;
+
+/**
+ * Inflate a tarball into a buffer from the pool, sized exactly from its
+ * trusted ISIZE, on up to kInflateThreads for large tarballs. The CRC-32 and
+ * ISIZE are verified, so a corrupt tarball never reaches tar::read.
+ *
+ * @return the tar archive, empty if the stream does not inflate to isize bytes or fails its checksum
+ */
+auto inflate(buffers::Pool& pool, const std::vector<char>& content, unsigned int isize) -> buffers::Pool::Buffer {
+  auto inflated = pool.Acquire(isize);
+  if (Decompressor::FeedParallel(content.data(), content.size(), inflated.Data(), isize, true, kInflateThreads) != isize) return {};
+  inflated.Resize(isize);
+  return inflated;
+}
 
-      std::ofstream out(path);
-      out << i.second;
-      out.close();
+/**
+ * Inflate a tarball through the streaming inflater into reader, which gets the
+ * archive as it is produced, so only the 32 KB window and one tar header are
+ * held in memory
+ *
+ * @return false if the tarball cannot be inflated; entries before the error have been read
+ */
+auto inflate(const std::vector<char>& content, tar::Reader& reader) -> bool {
+  Inflater inflater([&reader](const unsigned char* data, size_t length) {
+    reader.Feed(data, length);
+  });
+  return inflater.Feed(content.data(), content.size()) >= 0 && inflater.Finish() >= 0;
+}
+
+struct Location {
+  std::string host;
+  std::string path;
+};
+
+/** Split a URL into its origin ("host[:port]", "https://" kept for https) and path */
+auto locate(const std::string& from) -> Location {
+  std::string scheme = from.substr(0, from.find("://"));
+  std::string a      = from.substr(from.find("://") + 3);
+  return Location{
+      .host = (scheme == "https" ? "https://" : "") + a.substr(0, a.find_first_of('/')),
+      .path = a.substr(a.find_first_of('/'))};
+}
+
+/** Registry mirrors from $NPMCI_MIRRORS, a comma separated list of hosts or URLs */
+auto mirrors() -> std::vector<std::string> {
+  std::vector<std::string> hosts;
+  const char* env = std::getenv("NPMCI_MIRRORS");
+  std::string list = env ? env : "";
+
+  size_t start = 0;
+  while (start < list.size()) {
+    size_t end       = std::min(list.find(',', start), list.size());
+    std::string entry = list.substr(start, end - start);
+    if (!entry.empty()) {
+      if (entry.find("://") == std::string::npos) entry = "http://" + entry;
+      hosts.emplace_back(locate(entry + "/").host);
     }
+    start = end + 1;
   }
+  return hosts;
 }
 
-auto inflate(const http::Response& response) -> unsigned char* {
-  try {
-    size_t deflatedBufferSize = response.content.size();  //response.size;
-    size_t inflatedBufferSize = 20000000;
-    auto* deflatedData        = static_cast<const char*>(response.content.data());
-    auto* inflatedData        = new unsigned char[inflatedBufferSize];
-
-    unsigned int inflatedSize = Decompressor::Feed(deflatedData, deflatedBufferSize, inflatedData, inflatedBufferSize, false);
-    if (inflatedSize == -1) {
-      std::cout << "decompression error!" << std::endl;
-      return new unsigned char[1];
-    } else {
-      return inflatedData;
+void check_status(const http::Response& response, const std::string& from) {
+  if (response.status != 200) {
+    throw http::TransferException{"Unexpected status " + std::to_string(response.status) + " for " + from};
+  }
+}
+
+/** Download from the resolved host, failing over to the mirrors when it cannot be reached */
+auto download(http::Pool& pool, const Dependency& dep, const std::vector<std::string>& mirrors) -> http::Response {
+  auto [host, path] = locate(dep.resolved);
+  std::vector<std::string> hosts{host};
+  hosts.insert(hosts.end(), mirrors.begin(), mirrors.end());
+
+  for (size_t i = 0;; i++) {
+    integrity::Checker checker(dep.integrity);
+    try {
+      auto cli      = pool.Acquire(hosts[i]);
+      auto response = cli->Download(path, nullptr, [&checker](const char* data, size_t size) {
+        checker.Update(data, size);
+      });
+      check_status(response, dep.resolved);
+      checker.Verify();
+      return response;
+    } catch (const http::ConnectionException&) {
+      if (i + 1 == hosts.size()) throw;
+    } catch (const http::TransferException&) {
+      if (i + 1 == hosts.size()) throw;
     }
-  } catch (std::exception& e) {
-    std::cout << e.what() << std::endl;
-    return new unsigned char[1];
   }
 }
 
-auto untar(unsigned char* from) {
-  if (from[0] == '\0') return tar::Content{};
-  return tar::read(from, "package/");
+/** @return expected tarball size, unknown sizes rank first as they may be large */
+auto hint(const cache::Sizes& sizes, const Dependency& dep) -> size_t {
+  auto size = sizes.Get(dep.resolved);
+  return size == 0 ? SIZE_MAX : size;
 }
 
-auto download(const std::string& from) {
-  // todo: reuse existing connections
+/** Order dependencies largest first, so big tarballs start early and the pipeline drains evenly */
+void schedule(Dependencies& dependencies, const cache::Sizes& sizes) {
+  std::stable_sort(dependencies.begin(), dependencies.end(), [&sizes](const Dependency& a, const Dependency& b) {
+    return hint(sizes, a) > hint(sizes, b);
+  });
+}
 
-  std::string a    = from.substr(from.find("://") + 3);
-  std::string host = a.substr(0, a.find_first_of('/'));
-  std::string path = a.substr(a.find_first_of('/'));
+/** Keep a downloaded tarball for later installs; a failing cache never fails the install */
+void store(const cache::Store& cache, const Dependency& dep, const std::vector<char>& content) {
+  try {
+    cache.Write(dep.integrity, content);
+  } catch (const std::exception& e) {
+    std::cerr << "warning " << dep.resolved << ": " << e.what() << std::endl;
+  }
+}
 
-  http::Client cli{host};
-  return cli.Download(path);
+/** @return whether a cached tarball still matches its integrity, the entry is evicted otherwise */
+auto verify_cached(const cache::Store& cache, const Dependency& dep, const std::vector<char>& content) -> bool {
+  integrity::Checker checker(dep.integrity);
+  checker.Update(content.data(), content.size());
+  try {
+    checker.Verify();
+    return true;
+  } catch (const integrity::IntegrityException& e) {
+    std::cerr << "warning " << dep.resolved << ": cached tarball evicted, " << e.what() << std::endl;
+    cache.Remove(dep.integrity);
+    return false;
+  }
+}
+
+void extract(buffers::Pool& pool, fs::Directories& directories, const Dependency& dep, const regex::List& list, const std::vector<char>& content, bool verbose) {
+  try {
+    verbose&& std::cout << "inflating: " << dep.resolved << std::endl;
+    unsigned int isize = trusted_size(content);
+    if (isize) {
+      auto inflated = inflate(pool, content, isize);
+      if (!inflated.Size()) {  // corrupt: nothing of it is written
+        std::cerr << "error " << dep.resolved << ": decompression failed or checksum mismatch" << std::endl;
+        return;
+      }
+      verbose&& std::cout << "create_fs: " << dep.path << std::endl;
+      create_fs(directories, dep.path, list, tar::read(inflated.Data(), inflated.Size(), "package/"));
+      return;
+    }
+
+    // the trailer cannot be trusted to size a buffer: write entries while the stream inflates
+    Extraction extraction;
+    tar::Reader reader("package/", create_fs(directories, dep.path, list, extraction));
+    std::string error;
+    if (!inflate(content, reader)) {
+      error = "decompression failed or checksum mismatch";
+    } else if (reader.Failed()) {
+      error = "corrupt tar header";
+    } else if (extraction.out) {
+      error = "archive ends inside a file";
+    } else {
+      error = extraction.error;
+    }
+    if (!error.empty()) {  // what was written before the error goes again
+      extraction.Undo();
+      std::cerr << "error " << dep.resolved << ": " << error << std::endl;
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "error " << dep.resolved << ": " << e.what() << std::endl;
+  }
 }
 
 auto main(int argc, char* argv[]) -> int {
@@ -87,6 +288,7 @@ auto main(int argc, char* argv[]) -> int {
   const bool include_dev = args::get("dev", false);
   const bool include_opt = args::get("optional", false);
   const bool verbose     = args::get("verbose", false);
+  const bool use_cache   = !args::get("no-cache", false);
   const std::string file = "package-lock.json";  // todo: choose file as argument
 
   std::vector<std::string> template_list = fs::read_ignore(".pkgignore");
@@ -109,20 +311,85 @@ auto main(int argc, char* argv[]) -> int {
       return 1;
     }
 
-    ThreadPool tp(std::thread::hardware_concurrency());
-
-    for (auto& a : cleanedDependencies) {
-      tp.enqueue([verbose](const Dependency& _a, const regex::List& _b) {
-        verbose&& std::cout << "downloading: " << _a.resolved << std::endl;
-        auto c = download(_a.resolved);
-        verbose&& std::cout << "inflating: " << _a.resolved << std::endl;
-        auto* d = inflate(c);
-        verbose&& std::cout << "untar: " << _a.resolved << std::endl;
-        auto e = untar(d);
-        verbose&& std::cout << "create_fs: " << _a.path << std::endl;
-        create_fs(_a.path, _b, e);
-      },
-          a, list);
+    cache::Store tarballs(cache::Store::DefaultRoot());
+    cache::Sizes sizes(use_cache ? tarballs.Root() + "/sizes" : "");
+    const auto registries = mirrors();
+    schedule(cleanedDependencies, sizes);
+    buffers::Pool buffer_pool;  // inflate buffers are recycled across packages, outliving the workers
+    fs::Directories directories;  // created once for all packages, however many files land in them
+    {  // workers are joined before the size table is saved
+      ThreadPool tp(std::thread::hardware_concurrency());
+
+      // tarballs already in the cache are extracted without touching the network
+      Dependencies missing;
+      for (auto& a : cleanedDependencies) {
+        std::vector<char> cached;
+        if (use_cache && tarballs.Read(a.integrity, cached) && verify_cached(tarballs, a, cached)) {
+          verbose&& std::cout << "cached: " << a.resolved << std::endl;
+          sizes.Record(a.resolved, cached.size());
+          tp.enqueue(extract, std::ref(buffer_pool), std::ref(directories), a, list, std::move(cached), verbose);
+        } else {
+          missing.emplace_back(a);
+        }
+      }
+
+#ifdef __linux__
+      // network I/O is multiplexed on the event loop, workers only inflate and extract
+      http::EventLoop loop;
+
+      for (auto& a : missing) {
+        auto [host, path] = locate(a.resolved);
+        auto checker      = std::make_shared<integrity::Checker>(a.integrity);
+        verbose&& std::cout << "downloading: " << a.resolved << std::endl;
+
+        loop.Submit(http::Request{
+            .host       = host,
+            .path       = path,
+            .onReceived = [checker](const char* data, size_t size) {
+              checker->Update(data, size);
+            },
+            .mirrors    = registries,
+            .sizeHint   = hint(sizes, a),
+            .onDone     = [&tp, &list, &tarballs, &sizes, &buffer_pool, &directories, use_cache, verbose, a, checker](http::Response&& response) {
+              check_status(response, a.resolved);
+              checker->Verify();
+              sizes.Record(a.resolved, response.content.size());
+              tp.enqueue([&tarballs, &buffer_pool, &directories, use_cache, verbose](const Dependency& _a, const regex::List& _b, const std::vector<char>& _c) {
+                if (use_cache) store(tarballs, _a, _c);
+                extract(buffer_pool, directories, _a, _b, _c, verbose);
+              },
+                  a, list, std::move(response.content));
+            },
+            .onError    = [a](const std::exception& e) {
+              std::cerr << "error " << a.resolved << ": " << e.what() << std::endl;
+            }});
+      }
+
+      loop.Wait();
+#else
+      http::Pool pool;
+
+      for (auto& a : missing) {
+        tp.enqueue([verbose, use_cache, &pool, &tarballs, &sizes, &registries, &buffer_pool, &directories](const Dependency& _a, const regex::List& _b) {
+          try {
+            verbose&& std::cout << "downloading: " << _a.resolved << std::endl;
+            auto c = download(pool, _a, registries);
+            sizes.Record(_a.resolved, c.content.size());
+            if (use_cache) store(tarballs, _a, c.content);
+            extract(buffer_pool, directories, _a, _b, c.content, verbose);
+          } catch (const std::exception& e) {
+            std::cerr << "error " << _a.resolved << ": " << e.what() << std::endl;
+          }
+        },
+            a, list);
+      }
+#endif
+    }
+
+    try {
+      sizes.Save();
+    } catch (const std::exception& e) {
+      std::cerr << "warning " << e.what() << std::endl;
     }
   } catch (const std::exception& e) {
     std::cout << "error main " << e.what() << std::endl;
@@ -0,0 +1,705 @@
+#ifndef NPM_EVENT_LOOP_HPP
+#define NPM_EVENT_LOOP_HPP
+
+#ifdef __linux__
+
+#  include "http.hpp"
+#  include <atomic>
+#  include <chrono>
+#  include <condition_variable>
+#  include <deque>
+#  include <thread>
+#  include <unordered_map>
+
+#  include <sys/epoll.h>
+#  include <sys/eventfd.h>
+
+namespace http {
+  struct Request {
+    std::string host;
+    std::string path;
+    std::string method = "GET";
+    Headers headers{};
+    BodyCallback onBody{};
+    BodyCallback onReceived{};
+    RetryPolicy retry{};
+    std::vector<std::string> mirrors{};  // hosts serving the same paths, used to hedge slow requests
+    std::chrono::milliseconds hedgeAfter{300};
+    size_t sizeHint = 0;  // expected body size; larger requests of a host are sent first
+    std::function<void(Response&&)> onDone{};
+    std::function<void(const std::exception&)> onError{};
+  };
+
+  /**
+   * Single-threaded epoll transport. Requests are submitted from any thread and
+   * multiplexed over non-blocking keep-alive connections, at most
+   * maxConnectionsPerHost per host. Callbacks run on the I/O thread, so they
+   * should hand heavy work (inflate, untar) over to a worker pool.
+   *
+   * New connections race the resolved addresses Happy Eyeballs style: another
+   * address is tried every kAttemptDelay until one of the attempts connects.
+   *
+   * Failed requests are retried after an exponential backoff according to their
+   * RetryPolicy, asking only for the bytes that are still missing.
+   *
+   * A request with mirrors that has not received a byte hedgeAfter after it was
+   * sent is issued once more to a mirror. Whichever copy receives its first byte
+   * first wins; the other one is cancelled before it delivers anything. Resumed
+   * requests are never hedged.
+   *
+   * Requests waiting for a connection are ordered by sizeHint, largest first,
+   * so big bodies start early and the tail of an install drains evenly.
+   *
+   * Hosts written as "https://host[:port]" are reached over TLS; new connections
+   * resume the last session of the origin to skip most of the handshake.
+   */
+  class EventLoop {
+  public:
+    explicit EventLoop(size_t maxConnectionsPerHost = 32, Resolver& resolver = Resolver::Global(), TlsContext& tls = TlsContext::Global())
+        : _maxConnectionsPerHost(maxConnectionsPerHost), _resolver(resolver), _tls(tls) {
+      this->_epoll = ::epoll_create1(EPOLL_CLOEXEC);
+      this->_wake  = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+      if (this->_epoll < 0 || this->_wake < 0) {
+        throw ConnectionException{"Unable to create event loop"};
+      }
+
+      epoll_event event{};
+      event.events  = EPOLLIN;
+      event.data.fd = this->_wake;
+      ::epoll_ctl(this->_epoll, EPOLL_CTL_ADD, this->_wake, &event);
+
+      this->_thread = std::thread([this]() {
+        this->Run();
+      });
+    }
+
+    EventLoop(const EventLoop&) = delete;
+    auto operator=(const EventLoop&) -> EventLoop& = delete;
+
+    ~EventLoop() {
+      this->_stop = true;
+      this->Wake();
+      this->_thread.join();
+
+      for (auto& [fd, connection] : this->_sockets) {
+        ::close(fd);
+      }
+      ::close(this->_wake);
+      ::close(this->_epoll);
+    }
+
+    void Submit(Request request) {
+      {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        this->_incoming.emplace_back(std::move(request));
+        this->_outstanding++;
+      }
+      this->Wake();
+    }
+
+    /** Block until every submitted request has completed or failed */
+    void Wait() {
+      std::unique_lock<std::mutex> lock(this->_mutex);
+      this->_drained.wait(lock, [this] {
+        return this->_outstanding == 0;
+      });
+    }
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Job {
+      explicit Job(Request&& _request)
+          : request(std::move(_request)), resume(request.onBody, request.onReceived), backoff(request.retry.backoff) {}
+
+      Request request;
+      Resume resume;
+      bool retried = false;
+      int attempt  = 1;
+      std::chrono::milliseconds backoff;
+      Clock::time_point attemptDeadline;
+      bool hedged    = false;
+      Job* sibling   = nullptr;  // the other copy of a hedged request while both race
+      Clock::time_point hedgeAt;
+    };
+
+    enum class State { Connecting,
+      Handshaking,
+      Sending,
+      Receiving,
+      Idle };
+
+    struct Connection {
+      int fd = -1;
+      std::string host;
+      State state = State::Connecting;
+#  ifdef NPMCI_TLS
+      std::unique_ptr<TlsStream> tls;
+      bool readWaitsForWrite = false;  // TLS needs to write before it can read on
+#  endif
+      std::vector<int> attempts;
+      size_t nextAddress = 0;
+      Clock::time_point nextAttempt;
+      std::unique_ptr<Job> job;
+      std::unique_ptr<Parser> parser;
+      std::string out;
+      size_t sent   = 0;
+      bool reused   = false;
+      bool received = false;
+      Clock::time_point deadline;
+    };
+
+    struct Host {
+      std::deque<std::unique_ptr<Job>> pending;
+      std::vector<Connection*> idle;
+      size_t connections = 0;
+      Origin origin;
+      Addresses addresses;
+    };
+
+    void Wake() const {
+      uint64_t one = 1;
+      ::write(this->_wake, &one, sizeof(one));  // NOLINT(bugprone-unused-return-value)
+    }
+
+    void Run() {
+      epoll_event events[256];
+
+      int wait = 1000;
+      while (!this->_stop) {
+        int count = ::epoll_wait(this->_epoll, events, 256, wait);
+
+        for (int i = 0; i < count; i++) {
+          if (events[i].data.fd == this->_wake) {
+            this->TakeIncoming();
+          } else {
+            this->Handle(events[i].data.fd);
+          }
+        }
+
+        wait = this->Expire();
+      }
+    }
+
+    void TakeIncoming() {
+      uint64_t value;
+      ::read(this->_wake, &value, sizeof(value));  // NOLINT(bugprone-unused-return-value)
+
+      std::vector<Request> incoming;
+      {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        incoming.swap(this->_incoming);
+      }
+
+      for (auto& request : incoming) {
+        std::string host = request.host;
+        this->Enqueue(this->_hosts[host], std::make_unique<Job>(std::move(request)));
+        this->Dispatch(host);
+      }
+    }
+
+    /** Queue a job behind every pending job with at least its size hint */
+    static void Enqueue(Host& host, std::unique_ptr<Job> job) {
+      auto hint     = job->request.sizeHint;
+      auto position = std::find_if(host.pending.begin(), host.pending.end(), [hint](const auto& pending) {
+        return pending->request.sizeHint < hint;
+      });
+      host.pending.insert(position, std::move(job));
+    }
+
+    /** Hand pending jobs of a host to idle connections, opening new ones up to the limit */
+    void Dispatch(const std::string& hostName) {
+      auto& host = this->_hosts[hostName];
+
+      while (!host.pending.empty()) {
+        auto job = std::move(host.pending.front());
+        host.pending.pop_front();
+
+        if (!host.idle.empty()) {
+          auto& connection = *host.idle.back();
+          host.idle.pop_back();
+
+          try {
+            this->Start(connection, std::move(job));
+          } catch (const std::exception& e) {
+            this->Fail(connection, e);
+          }
+        } else if (host.connections < this->_maxConnectionsPerHost) {
+          try {
+            this->Open(hostName, host).job = std::move(job);
+          } catch (const std::exception& e) {
+            this->Abandon(std::move(job), e);
+          }
+        } else {
+          host.pending.emplace_front(std::move(job));
+          break;
+        }
+      }
+    }
+
+    auto Open(const std::string& hostName, Host& host) -> Connection& {
+      if (host.addresses.empty()) {
+        host.origin    = parse_origin(hostName);
+        host.addresses = this->_resolver.Resolve(host.origin.host, host.origin.port);
+      }
+
+      auto connection      = std::make_unique<Connection>();
+      connection->host     = hostName;
+      connection->deadline = Clock::now() + kTimeout;
+      this->Attempt(*connection, host);
+
+      host.connections++;
+      auto* opened = connection.get();
+      this->_connections.emplace(opened, std::move(connection));
+      return *opened;
+    }
+
+    /** Start connecting to the next address of the host */
+    void Attempt(Connection& connection, const Host& host) {
+      if (connection.nextAddress >= host.addresses.size()) {
+        throw ResolveException{"No usable address for host '" + host.origin.host + "'"};
+      }
+
+      const auto& address = host.addresses[connection.nextAddress++];
+      int fd              = int(createSocket(address.family));
+      ::connect(fd, address.Get(), address.length);  // NOLINT(bugprone-unused-return-value)
+
+      epoll_event event{};
+      event.events  = EPOLLOUT;
+      event.data.fd = fd;
+      ::epoll_ctl(this->_epoll, EPOLL_CTL_ADD, fd, &event);
+
+      connection.attempts.push_back(fd);
+      connection.nextAttempt = Clock::now() + kAttemptDelay;
+      this->_sockets.emplace(fd, &connection);
+    }
+
+    void Connected(Connection& connection, int fd) {
+      auto& host = this->_hosts[connection.host];
+      if (socketError(fd) != 0) {  // move on to the next address right away
+        this->Forget(connection, fd);
+        if (connection.nextAddress < host.addresses.size()) {
+          this->Attempt(connection, host);
+        } else if (connection.attempts.empty()) {
+          throw ConnectionException{"Unable to connect to host"};
+        }
+        return;
+      }
+
+      for (int attempt : std::vector<int>(connection.attempts)) {
+        if (attempt != fd) this->Forget(connection, attempt);
+      }
+      connection.attempts.clear();
+      connection.fd = fd;
+
+      if (host.origin.secure) {
+#  ifdef NPMCI_TLS
+        connection.tls   = std::make_unique<TlsStream>(this->_tls, fd, host.origin.host, connection.host);
+        connection.state = State::Handshaking;
+        this->Handshake(connection);
+#  else
+        throw ConnectionException{"https is not supported by this build"};
+#  endif
+      } else {
+        this->Start(connection, std::move(connection.job));
+      }
+    }
+
+#  ifdef NPMCI_TLS
+    void Handshake(Connection& connection) {
+      int result = connection.tls->Handshake();
+      if (result == TlsStream::kWouldBlock) {
+        this->Watch(connection, connection.tls->WantsWrite() ? EPOLLOUT : EPOLLIN);
+        return;
+      }
+      if (result < 0) {
+        throw ConnectionException{"TLS handshake failed: " + connection.tls->Error()};
+      }
+      this->Start(connection, std::move(connection.job));
+    }
+#  endif
+
+    void Forget(Connection& connection, int fd) {
+      auto& attempts = connection.attempts;
+      attempts.erase(std::remove(attempts.begin(), attempts.end(), fd), attempts.end());
+      ::epoll_ctl(this->_epoll, EPOLL_CTL_DEL, fd, nullptr);
+      ::close(fd);
+      this->_sockets.erase(fd);
+    }
+
+    void Start(Connection& connection, std::unique_ptr<Job> job) {
+      auto& request = job->request;
+      Headers headers = default_headers();
+      for (const auto& [key, value] : request.headers) {
+        headers.insert_or_assign(key, value);
+      }
+
+      job->attemptDeadline  = Clock::now() + request.retry.attemptTimeout;
+      job->hedgeAt          = Clock::now() + request.hedgeAfter;
+      connection.out        = build_request(request.method, request.path, this->_hosts[connection.host].origin.authority, job->resume.Apply(headers));
+      connection.sent       = 0;
+      connection.received   = false;
+      connection.parser     = job->resume.NewParser(request.method == "HEAD");
+      connection.job        = std::move(job);
+      connection.state      = State::Sending;
+      connection.deadline   = Clock::now() + kTimeout;
+      this->Watch(connection, EPOLLOUT);
+      this->Write(connection);
+    }
+
+    void Watch(const Connection& connection, uint32_t events) const {
+      epoll_event event{};
+      event.events  = events;
+      event.data.fd = connection.fd;
+      ::epoll_ctl(this->_epoll, EPOLL_CTL_MOD, connection.fd, &event);
+    }
+
+    void Handle(int fd) {
+      auto found = this->_sockets.find(fd);
+      if (found == this->_sockets.end()) return;
+      auto& connection = *found->second;
+
+      try {
+        switch (connection.state) {
+          case State::Connecting:
+            this->Connected(connection, fd);
+            break;
+
+          case State::Handshaking:
+#  ifdef NPMCI_TLS
+            this->Handshake(connection);
+#  endif
+            break;
+
+          case State::Sending:
+            this->Write(connection);
+            break;
+
+          case State::Receiving:
+            this->Read(connection);
+            break;
+
+          case State::Idle:  // server closed or sent garbage on an idle keep-alive connection
+            if (!this->Quiet(connection)) this->Close(connection);
+            break;
+        }
+      } catch (const std::exception& e) {
+        this->Fail(connection, e);
+      }
+    }
+
+    void Write(Connection& connection) {
+      while (connection.sent < connection.out.size()) {
+        const char* data = connection.out.data() + connection.sent;
+        size_t size      = connection.out.size() - connection.sent;
+        int wrote;
+#  ifdef NPMCI_TLS
+        if (connection.tls) {
+          wrote = connection.tls->Write(data, size);
+          if (wrote == TlsStream::kWouldBlock) {
+            this->Watch(connection, connection.tls->WantsWrite() ? EPOLLOUT : EPOLLIN);
+            return;
+          }
+        } else
+#  endif
+        {
+          wrote = send_bytes(connection.fd, data, size);
+          if (wrote < 0 && would_block()) return;
+        }
+        if (wrote <= 0) throw ClosedException{"Unable to transfer request to source"};
+        connection.sent += wrote;
+      }
+
+      connection.state = State::Receiving;
+      this->Watch(connection, EPOLLIN | EPOLLRDHUP);
+    }
+
+    void Read(Connection& connection) {
+      auto& parser = *connection.parser;
+
+      while (!parser.Done()) {
+        auto [window, windowSize] = parser.BodyWindow();
+        bool direct               = windowSize > 0;
+        char* target              = direct ? window : this->_buffer.data();
+        size_t targetSize         = direct ? windowSize : this->_buffer.size();
+
+        auto receivedBytes = this->Receive(connection, target, targetSize);
+        if (receivedBytes < 0) return;
+
+        if (receivedBytes == 0) {
+          parser.Finish();
+        } else {
+          if (!connection.received && connection.job->sibling) {  // first byte wins the race
+            this->Cancel(connection.job->sibling);
+            connection.job->sibling = nullptr;
+          }
+          connection.received = true;
+          connection.deadline = Clock::now() + kTimeout;
+          if (direct) {
+            parser.Commit(receivedBytes);
+          } else if (parser.Feed(target, receivedBytes) < size_t(receivedBytes)) {
+            throw TransferException{"Unexpected bytes after response"};
+          }
+        }
+      }
+
+      this->Complete(connection);
+    }
+
+    /**
+     * @return bytes received, 0 once the server closed the connection,
+     *         -1 when nothing is available yet
+     */
+    auto Receive(Connection& connection, char* target, size_t size) -> ssize_t {
+#  ifdef NPMCI_TLS
+      if (connection.tls) {
+        if (connection.readWaitsForWrite) {
+          connection.readWaitsForWrite = false;
+          this->Watch(connection, EPOLLIN | EPOLLRDHUP);
+        }
+
+        int receivedBytes = connection.tls->Read(target, size);
+        if (receivedBytes == TlsStream::kWouldBlock) {
+          if (connection.tls->WantsWrite()) {
+            connection.readWaitsForWrite = true;
+            this->Watch(connection, EPOLLOUT);
+          }
+          return -1;
+        }
+        if (receivedBytes < 0) throw TransferException{"Unable to receive response bytes: " + connection.tls->Error()};
+        return receivedBytes;
+      }
+#  endif
+      auto receivedBytes = ::recv(connection.fd, target, size, 0);
+      if (receivedBytes < 0 && would_block()) return -1;
+      if (receivedBytes < 0) throw TransferException{"Unable to receive response bytes"};
+      return receivedBytes;
+    }
+
+    /** @return whether an idle connection only saw TLS records without data, e.g. late session tickets */
+    auto Quiet(Connection& connection) -> bool {
+#  ifdef NPMCI_TLS
+      if (connection.tls) {
+        return connection.tls->Read(this->_buffer.data(), this->_buffer.size()) == TlsStream::kWouldBlock;
+      }
+#  endif
+      return false;
+    }
+
+    void Complete(Connection& connection) {
+      auto job      = std::move(connection.job);
+      auto response = job->resume.Finish(*connection.parser);
+      std::string hostName = connection.host;
+
+      if (connection.parser->KeepAlive()) {
+        connection.parser.reset();
+        connection.reused = true;
+        connection.state  = State::Idle;
+        this->Watch(connection, EPOLLIN | EPOLLRDHUP);
+        this->_hosts[hostName].idle.push_back(&connection);
+      } else {
+        this->Close(connection);
+      }
+
+      try {
+        if (job->request.onDone) job->request.onDone(std::move(response));
+      } catch (const std::exception& e) {
+        if (job->request.onError) job->request.onError(e);
+      }
+      this->Finished();
+      this->Dispatch(hostName);
+    }
+
+    void Fail(Connection& connection, const std::exception& e) {
+      auto job             = std::move(connection.job);
+      bool stale           = job && connection.reused && !connection.received && !job->retried;
+      std::string hostName = connection.host;
+      bool resumable       = !job || !connection.parser || stale || job->resume.Keep(*connection.parser);
+      this->Close(connection);
+
+      if (stale) {  // idle keep-alive connection was dropped by the server, retry once on a fresh one
+        job->retried = true;
+        this->_hosts[hostName].pending.emplace_front(std::move(job));
+      } else if (job && resumable && job->attempt < job->request.retry.attempts) {
+        auto at = Clock::now() + job->backoff;
+        job->attempt++;
+        job->backoff *= 2;
+        this->_delayed.emplace(at, std::move(job));
+      } else if (job) {
+        this->Abandon(std::move(job), e);
+      }
+      this->Dispatch(hostName);
+    }
+
+    /** Give up on a job; a hedged copy still racing takes over silently */
+    void Abandon(std::unique_ptr<Job> job, const std::exception& e) {
+      if (job->sibling) {
+        job->sibling->sibling = nullptr;
+        return;
+      }
+      if (job->request.onError) job->request.onError(e);
+      this->Finished();
+    }
+
+    /** Drop the losing copy of a hedged request wherever it currently is */
+    void Cancel(Job* job) {
+      for (auto& [pointer, connection] : this->_connections) {
+        if (connection->job.get() == job) {
+          std::string hostName = connection->host;
+          connection->job.reset();
+          this->Close(*connection);
+          this->Dispatch(hostName);  // the freed slot may be what queued jobs of that host wait for
+          return;
+        }
+      }
+
+      auto& pending = this->_hosts[job->request.host].pending;
+      auto queued   = std::find_if(pending.begin(), pending.end(), [job](const auto& i) { return i.get() == job; });
+      if (queued != pending.end()) {
+        pending.erase(queued);
+        return;
+      }
+
+      for (auto delayed = this->_delayed.begin(); delayed != this->_delayed.end(); ++delayed) {
+        if (delayed->second.get() == job) {
+          this->_delayed.erase(delayed);
+          return;
+        }
+      }
+    }
+
+    /** Issue a copy of a request that is waiting too long for its first byte to a mirror */
+    void Hedge(Job& job) {
+      job.hedged  = true;
+      auto mirror = std::find_if(job.request.mirrors.begin(), job.request.mirrors.end(), [&job](const std::string& host) {
+        return host != job.request.host;
+      });
+      if (mirror == job.request.mirrors.end()) return;
+
+      Request request = job.request;
+      request.host    = *mirror;
+      auto copy       = std::make_unique<Job>(std::move(request));
+      copy->hedged    = true;
+      copy->sibling   = &job;
+      job.sibling     = copy.get();
+
+      this->Enqueue(this->_hosts[*mirror], std::move(copy));
+      this->Dispatch(*mirror);
+    }
+
+    void Close(Connection& connection) {
+      auto& host = this->_hosts[connection.host];
+      host.idle.erase(std::remove(host.idle.begin(), host.idle.end(), &connection), host.idle.end());
+      host.connections--;
+
+      for (int attempt : std::vector<int>(connection.attempts)) {
+        this->Forget(connection, attempt);
+      }
+#  ifdef NPMCI_TLS
+      connection.tls.reset();
+#  endif
+      if (connection.fd >= 0) {
+        this->Forget(connection, connection.fd);
+      }
+      this->_connections.erase(&connection);
+    }
+
+    /**
+     * Fail connections past their deadline, start delayed connection attempts
+     * and requeue requests whose retry backoff has passed
+     *
+     * @return milliseconds until the next pending attempt or retry, at most one second
+     */
+    auto Expire() -> int {
+      auto now  = Clock::now();
+      auto next = now + std::chrono::seconds(1);
+      std::vector<Connection*> expired;
+      std::vector<Connection*> racing;
+      std::vector<Job*> slow;
+
+      for (const auto& [pointer, connection] : this->_connections) {
+        bool started = connection->state == State::Sending || connection->state == State::Receiving;
+        bool overdue = connection->deadline < now || (started && connection->job->attemptDeadline < now);
+        // a resumed job is not hedged: its callbacks already saw the kept bytes a copy would deliver again
+        bool hedgeable = started && !connection->job->hedged && connection->job->resume.Offset() == 0 && !connection->job->request.mirrors.empty();
+        if (hedgeable && !overdue && !connection->received) {
+          if (connection->job->hedgeAt <= now) {
+            slow.push_back(connection->job.get());
+          } else {
+            next = std::min(next, connection->job->hedgeAt);
+          }
+        }
+
+        if (connection->state != State::Idle && overdue) {
+          expired.push_back(pointer);
+        } else if (connection->state == State::Connecting && connection->nextAddress < this->_hosts[connection->host].addresses.size()) {
+          if (connection->nextAttempt <= now) {
+            racing.push_back(pointer);
+          } else {
+            next = std::min(next, connection->nextAttempt);
+          }
+        }
+      }
+
+      for (auto* connection : racing) {
+        this->Attempt(*connection, this->_hosts[connection->host]);
+        next = std::min(next, connection->nextAttempt);
+      }
+      for (auto* job : slow) {
+        this->Hedge(*job);
+      }
+      for (auto* connection : expired) {
+        this->Fail(*connection, TransferException{"Timeout while receiving response"});
+      }
+
+      std::vector<std::string> retried;
+      while (!this->_delayed.empty() && this->_delayed.begin()->first <= now) {
+        auto job = std::move(this->_delayed.begin()->second);
+        this->_delayed.erase(this->_delayed.begin());
+        retried.push_back(job->request.host);
+        auto& host = this->_hosts[job->request.host];
+        this->Enqueue(host, std::move(job));
+      }
+      for (const auto& host : retried) {
+        this->Dispatch(host);
+      }
+      if (!this->_delayed.empty()) {
+        next = std::min(next, this->_delayed.begin()->first);
+      }
+
+      return int(std::chrono::duration_cast<std::chrono::milliseconds>(next - now).count()) + 1;
+    }
+
+    void Finished() {
+      std::lock_guard<std::mutex> lock(this->_mutex);
+      if (--this->_outstanding == 0) {
+        this->_drained.notify_all();
+      }
+    }
+
+    static constexpr auto kTimeout = std::chrono::seconds(30);
+
+    size_t _maxConnectionsPerHost;
+    Resolver& _resolver;
+    TlsContext& _tls;
+    int _epoll = -1;
+    int _wake  = -1;
+    std::atomic<bool> _stop{false};
+    std::thread _thread;
+
+    std::mutex _mutex;
+    std::condition_variable _drained;
+    std::vector<Request> _incoming;
+    size_t _outstanding = 0;
+
+    std::unordered_map<Connection*, std::unique_ptr<Connection>> _connections;
+    std::unordered_map<int, Connection*> _sockets;
+    std::map<std::string, Host> _hosts;
+    std::multimap<Clock::time_point, std::unique_ptr<Job>> _delayed;
+    std::vector<char> _buffer = std::vector<char>(kReceiveBufferSize);
+  };
+}  // namespace http
+
+#endif  // __linux__
+
+#endif  //NPM_EVENT_LOOP_HPP
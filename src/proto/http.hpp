@@ -1,9 +1,25 @@
+#ifndef NPM_HTTP_HPP
+#define NPM_HTTP_HPP
+
+#include "resolver.hpp"
+#include "tls.hpp"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 
 #ifdef _WIN32
 #  include <winsock2.h>
+#  include <ws2tcpip.h>
 #  pragma comment(lib, "ws2_32")
 #else
 #  include <arpa/inet.h>
@@ -19,18 +35,24 @@
 #endif
 
 #ifndef BUF_SIZE
-#  define BUF_SIZE 102
+#  define BUF_SIZE 65536
 #endif
 
 #define LE "\r\n"
-#define CONTENT_LENGTH "Content-Length"
+#define CONTENT_LENGTH "content-length"
+#define CONNECTION "connection"
+#define TRANSFER_ENCODING "transfer-encoding"
 
 namespace http {
-  using Headers = std::map<std::string, std::string>;
+  constexpr size_t kReceiveBufferSize = BUF_SIZE;
+
+  using Headers      = std::map<std::string, std::string>;
+  using BodyCallback = std::function<void(const char*, size_t)>;
   struct Response {
     Headers headers;
     std::vector<char> content;
     int size{};
+    int status{};
   };
 
   class ConnectionException : public std::runtime_error {
@@ -43,20 +65,54 @@ namespace http {
     using std::runtime_error::runtime_error;
   };
 
+  class ClosedException : public TransferException {
+  public:
+    using TransferException::TransferException;
+  };
+
+  /** Parts of an origin written as "[https://]host[:port]" */
+  struct Origin {
+    bool secure = false;
+    std::string host;
+    unsigned short port = 80;
+    std::string authority;  // host[:port] as sent in the Host header
+  };
+
+  inline auto parse_origin(const std::string& origin) -> Origin {
+    Origin parsed;
+    parsed.authority = origin;
+    if (origin.compare(0, 8, "https://") == 0) {
+      parsed.secure    = true;
+      parsed.port      = 443;
+      parsed.authority = origin.substr(8);
+    } else if (origin.compare(0, 7, "http://") == 0) {
+      parsed.authority = origin.substr(7);
+    }
+
+    auto portStart = parsed.authority.find(':');
+    parsed.host    = parsed.authority.substr(0, portStart);
+    if (portStart != std::string::npos) {
+      parsed.port = (unsigned short) std::atoi(parsed.authority.c_str() + portStart + 1);  // NOLINT(cert-err34-c)
+    }
+    return parsed;
+  }
+
+  /** How often and how patiently an interrupted download is resumed */
+  struct RetryPolicy {
+    int attempts = 4;
+    std::chrono::milliseconds backoff{250};  // delay before the second attempt, doubled for every further one
+    std::chrono::seconds attemptTimeout{120};
+  };
+
   namespace {
     using Socket           = unsigned long long;
     using ConnectionResult = int;
-    using SocketAddress    = sockaddr_in;
 
-    auto createSocket() -> Socket {
-#ifdef _WIN32
-      // winsock must be initialized before use
-      WSADATA wsaData;
-      if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {  // NOLINT(hicpp-signed-bitwise)
-        WSACleanup();
-      }
-#endif
-      Socket sock = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    constexpr auto kAttemptDelay = std::chrono::milliseconds(250);
+
+    auto createSocket(int family = AF_INET) -> Socket {
+      startup();
+      Socket sock = ::socket(family, SOCK_STREAM, IPPROTO_TCP);
 #ifdef _WIN32  // Non-blocking flags
       auto on = 1UL;
       ::ioctlsocket(sock, FIONBIO, &on);  // NOLINT(hicpp-signed-bitwise)
@@ -76,51 +132,94 @@ namespace http {
 #endif
     }
 
-    auto detectHost(const std::string& host, const short port) -> SocketAddress {
-      SocketAddress sai{};
-      struct hostent* _host = ::gethostbyname(host.c_str());
-
-      if (_host) {
-        sai.sin_port        = htons(port);
-        sai.sin_family      = AF_INET;
-        sai.sin_addr.s_addr = decltype(sai.sin_addr.s_addr)(*(reinterpret_cast<unsigned long*>(_host->h_addr)));
-      } else {
-        throw ConnectionException{"Unable to resolve host"};
-      }
-      return sai;
-    }
-
-    void connect(Socket socket, SocketAddress address, timeval* to) {
-      int address_size     = sizeof(address);
-      auto* socket_address = reinterpret_cast<sockaddr*>(&address);
-      fd_set fdSet;
-
-      ::connect(socket, socket_address, address_size);  // NOLINT(bugprone-unused-return-value)
-
-      FD_ZERO(&fdSet);
-      FD_SET(socket, &fdSet);
-
-      ConnectionResult cr = ::select(socket + 1UL, nullptr, &fdSet, nullptr, to);
-      if (cr < 1) {
-        throw ConnectionException{"Unable to connect to host"};
-      }
-
-      int so_error;
+    auto socketError(Socket socket) -> int {
+      int so_error = 0;
 #ifdef _WIN32
-      using socklen_t = int;
       using SockOpt_t = char*;
 #else
       using SockOpt_t = void*;
 #endif
       socklen_t len = sizeof so_error;
       ::getsockopt(socket, SOL_SOCKET, SO_ERROR, reinterpret_cast<SockOpt_t>(&so_error), &len);
+      return so_error;
+    }
 
-      if (so_error != 0) {
-        throw ConnectionException("Timeout while acquiring connection to host");
+    /**
+     * Connect to the first address that answers. While earlier attempts are
+     * still pending, the next address is tried every kAttemptDelay (Happy Eyeballs).
+     */
+    auto connect(const Addresses& addresses, timeval* to) -> Socket {
+      using namespace std::chrono;
+      auto deadline = steady_clock::now() + seconds(to->tv_sec) + microseconds(to->tv_usec);
+      std::vector<Socket> attempts;
+      size_t next = 0;
+
+      auto closeAttempts = [&attempts](Socket keep) {
+        for (auto attempt : attempts) {
+          if (attempt != keep) closeSocket(attempt);
+        }
+      };
+
+      while (true) {
+        if (next < addresses.size()) {
+          const auto& address = addresses[next++];
+          Socket socket       = createSocket(address.family);
+          ::connect(socket, address.Get(), address.length);  // NOLINT(bugprone-unused-return-value)
+          attempts.push_back(socket);
+        }
+
+        auto now = steady_clock::now();
+        if (attempts.empty()) {
+          throw ConnectionException{"Unable to connect to host"};
+        }
+        if (now >= deadline) {
+          closeAttempts(INVALID_SOCKET);  // NOLINT(hicpp-signed-bitwise)
+          throw ConnectionException{"Timeout while acquiring connection to host"};
+        }
+
+        auto wait = duration_cast<microseconds>(deadline - now);
+        if (next < addresses.size()) wait = std::min<microseconds>(wait, kAttemptDelay);
+        timeval tv{.tv_sec = long(wait.count() / 1000000), .tv_usec = long(wait.count() % 1000000)};
+
+        fd_set writable;
+        fd_set failed;  // winsock reports refused connections as exceptions
+        FD_ZERO(&writable);
+        FD_ZERO(&failed);
+        Socket maxSocket = 0;
+        for (auto attempt : attempts) {
+          FD_SET(attempt, &writable);
+          FD_SET(attempt, &failed);
+          maxSocket = std::max(maxSocket, attempt);
+        }
+
+        if (::select(int(maxSocket + 1), nullptr, &writable, &failed, &tv) < 0) {
+          closeAttempts(INVALID_SOCKET);  // NOLINT(hicpp-signed-bitwise)
+          throw ConnectionException{"Unable to connect to host"};
+        }
+
+        for (auto attempt = attempts.begin(); attempt != attempts.end();) {
+          if (!FD_ISSET(*attempt, &writable) && !FD_ISSET(*attempt, &failed)) {
+            ++attempt;
+          } else if (FD_ISSET(*attempt, &writable) && socketError(*attempt) == 0) {
+            Socket socket = *attempt;
+            closeAttempts(socket);
+            return socket;
+          } else {
+            closeSocket(*attempt);
+            attempt = attempts.erase(attempt);
+          }
+        }
       }
     }
 
-    auto send_request(Socket socket, const std::string& _method, const std::string& _uri, const std::string& _host, const Headers& _headers) -> int {
+    auto default_headers() -> Headers {
+      return Headers{
+          {"Connection", "keep-alive"},
+          {"Accept", "*/*"},
+          {"User-Agent", "cpp-http/1.0"}};
+    }
+
+    auto build_request(const std::string& _method, const std::string& _uri, const std::string& _host, const Headers& _headers) -> std::string {
       std::string requestString;
       requestString.append(_method).append(" ").append(_uri).append(" ").append("HTTP/1.1").append(LE);
       requestString.append("Host:").append(" ").append(_host);
@@ -128,97 +227,487 @@ namespace http {
         requestString.append(LE).append(key).append(": ").append(value);
       }
       requestString.append(LE).append(LE);
-      return ::send(socket, requestString.c_str(), requestString.length(), 0);
+      return requestString;
     }
 
-    auto receive_bytes(Socket socket, char* buf, int len, timeval* to) -> int {
-      fd_set fdSet;
-      ConnectionResult connectionResult;
+    auto send_bytes(Socket socket, const char* data, size_t len) -> int {
+#ifdef MSG_NOSIGNAL
+      return int(::send(socket, data, len, MSG_NOSIGNAL));
+#else
+      return int(::send(socket, data, int(len), 0));
+#endif
+    }
 
+    /** @return whether the socket became readable, or writable, before the timeout */
+    auto wait_socket(Socket socket, bool write, timeval* to) -> bool {
+      fd_set fdSet;
       FD_ZERO(&fdSet);
       FD_SET(socket, &fdSet);
 
-      connectionResult = ::select(socket + 1UL, &fdSet, nullptr, nullptr, to);
-      if (connectionResult == INVALID_SOCKET) return -2;  // timeout! NOLINT(hicpp-signed-bitwise)
+      timeval wait = *to;
+      return ::select(int(socket + 1), write ? nullptr : &fdSet, write ? &fdSet : nullptr, nullptr, &wait) > 0;
+    }
+
+    auto would_block() -> bool {
 #ifdef _WIN32
-      if (connectionResult == SOCKET_ERROR) return -1;  // error
+      return ::WSAGetLastError() == WSAEWOULDBLOCK;
 #else
-      if (connectionResult == SO_ERROR) return -1;  // error
+      return errno == EAGAIN || errno == EWOULDBLOCK;
 #endif
-      return ::recv(socket, buf, len, 0);
     }
 
-    auto receive_response(Socket socket, timeval* to) {
-      std::vector<char> buf;
+    /**
+     * Receive available bytes, waiting for the socket only when nothing is buffered yet
+     *
+     * @return number of bytes received, 0 on orderly shutdown, -1 on error and -2 on timeout
+     */
+    auto receive_bytes(Socket socket, char* buf, int len, timeval* to) -> int {
+      auto receivedBytes = ::recv(socket, buf, len, 0);
+      if (receivedBytes >= 0 || !would_block()) return int(receivedBytes);
 
-      while (true) {
-        char buffer[BUF_SIZE]{};
-        auto receivedBytes = receive_bytes(socket, buffer, BUF_SIZE, to);
-        if (receivedBytes > 0) {
-          std::copy(&buffer[0], &buffer[receivedBytes], std::back_inserter(buf));
-        } else if (receivedBytes == 0) {
-          break;
+      fd_set fdSet;
+      FD_ZERO(&fdSet);
+      FD_SET(socket, &fdSet);
+
+      timeval wait = *to;
+      ConnectionResult connectionResult = ::select(socket + 1UL, &fdSet, nullptr, nullptr, &wait);
+      if (connectionResult == 0) return -2;  // timeout!
+      if (connectionResult < 0) return -1;   // error
+      return int(::recv(socket, buf, len, 0));
+    }
+
+    auto parse_headers(const std::string& headline) {
+      Headers headers;
+
+      size_t lineStart = headline.find(LE);
+      while (lineStart != std::string::npos) {
+        lineStart += 2;
+        size_t lineEnd = headline.find(LE, lineStart);
+        if (lineEnd == std::string::npos || lineEnd == lineStart) break;
+
+        size_t keyEnd = headline.find_first_of(':', lineStart);
+        if (keyEnd != std::string::npos && keyEnd < lineEnd) {
+          size_t valueStart = headline.find_first_not_of(' ', keyEnd + 1);
+          std::string key   = headline.substr(lineStart, keyEnd - lineStart);
+          std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return std::tolower(c); });
+          headers.emplace(key, valueStart < lineEnd ? headline.substr(valueStart, lineEnd - valueStart) : "");
+        }
+        lineStart = lineEnd;
+      }
+
+      return headers;
+    }
+  }  // namespace
+
+
+  /**
+   * Incremental HTTP/1.1 response parser. Bytes are pushed with Feed() as they
+   * arrive; headers are parsed as soon as they are complete and the body is
+   * framed by Content-Length, chunked transfer-encoding or connection close.
+   *
+   * Body bytes go to the callback when one is given, otherwise into a buffer that
+   * is pre-sized from Content-Length. While BodyWindow() is non-empty the caller
+   * may receive straight into it and Commit() the bytes, skipping the copy.
+   * The optional onReceived callback observes every body slice either way,
+   * e.g. to hash the body while it arrives.
+   *
+   * A parser for a resumed download (see Resume()) accepts 206 as well as 200
+   * and drops the leading bytes the caller already holds from a full 200 body.
+   */
+  class Parser {
+  public:
+    explicit Parser(BodyCallback onBody = nullptr, bool headRequest = false, BodyCallback onReceived = nullptr)
+        : _onBody(std::move(onBody)), _onReceived(std::move(onReceived)), _headRequest(headRequest) {}
+
+    /** @return number of bytes consumed; bytes past the end of the response are not consumed */
+    auto Feed(const char* data, size_t size) -> size_t {
+      size_t consumed = 0;
+      while (consumed < size && this->_state != State::Done) {
+        const char* current = data + consumed;
+        size_t left         = size - consumed;
+
+        switch (this->_state) {
+          case State::Head:
+            consumed += this->FeedHead(current, left);
+            break;
+
+          case State::Body:
+          case State::ChunkData: {
+            size_t n = this->_remaining < 0 ? left : std::min(left, size_t(this->_remaining));
+            this->Deliver(current, n);
+            consumed += n;
+            break;
+          }
+
+          case State::ChunkSize:
+          case State::ChunkEnd:
+          case State::Trailer:
+            consumed += this->FeedLine(current, left);
+            break;
+
+          case State::Done:
+            break;
+        }
+      }
+      return consumed;
+    }
+
+    /** Signal end of stream; completes close-delimited bodies and throws for truncated ones. */
+    void Finish() {
+      if (this->_state == State::Body && this->_remaining < 0) {
+        this->_keepAlive = false;
+        this->Complete();
+      }
+      if (this->_state != State::Done) {
+        if (this->_state == State::Head && this->_line.empty()) {
+          throw ClosedException{"Connection closed by remote host"};
+        }
+        throw TransferException{"Connection closed before the response was complete"};
+      }
+    }
+
+    auto BodyWindow() -> std::pair<char*, size_t> {
+      if (this->_state != State::Body || this->_onBody || this->_remaining <= 0 || this->_skip > 0) return {nullptr, 0};
+      return {this->_response.content.data() + this->_received, size_t(this->_remaining)};
+    }
+
+    void Commit(size_t n) {
+      if (this->_onReceived) this->_onReceived(this->_response.content.data() + this->_received, n);
+      this->_received += n;
+      this->Advance(n);
+    }
+
+    /** Expect the body from offset on; must be called before the response is fed */
+    void Resume(size_t offset) {
+      this->_resumeOffset = offset;
+    }
+
+    /** @return body bytes delivered so far, not counting skipped ones */
+    [[nodiscard]] auto Received() const noexcept -> size_t {
+      return this->_received;
+    }
+
+    [[nodiscard]] auto Done() const noexcept -> bool {
+      return this->_state == State::Done;
+    }
+
+    [[nodiscard]] auto HeadersDone() const noexcept -> bool {
+      return this->_state != State::Head;
+    }
+
+    [[nodiscard]] auto KeepAlive() const noexcept -> bool {
+      return this->_keepAlive;
+    }
+
+    [[nodiscard]] auto GetResponse() const noexcept -> const Response& {
+      return this->_response;
+    }
+
+    auto TakeResponse() -> Response {
+      return std::move(this->_response);
+    }
+
+  private:
+    enum class State { Head,
+      Body,
+      ChunkSize,
+      ChunkData,
+      ChunkEnd,
+      Trailer,
+      Done };
+
+    auto FeedHead(const char* data, size_t size) -> size_t {
+      size_t searchFrom = this->_line.size() < 3 ? 0 : this->_line.size() - 3;
+      this->_line.append(data, size);
+
+      size_t headEnd = this->_line.find(LE LE, searchFrom);
+      if (headEnd == std::string::npos) return size;
+
+      size_t used = headEnd + 4 - (this->_line.size() - size);
+      this->_line.resize(headEnd + 4);
+      this->ParseHead();
+      this->_line.clear();
+      return used;
+    }
+
+    void ParseHead() {
+      size_t statusStart = this->_line.find(' ');
+      if (this->_line.compare(0, 5, "HTTP/") != 0 || statusStart == std::string::npos) {
+        throw TransferException{"Malformed response"};
+      }
+
+      this->_response.status  = std::atoi(this->_line.c_str() + statusStart + 1);  // NOLINT(cert-err34-c)
+      this->_response.headers = parse_headers(this->_line);
+      this->_keepAlive        = this->_line.compare(0, 8, "HTTP/1.0") != 0;
+
+      auto& headers   = this->_response.headers;
+      auto connection = headers.find(CONNECTION);
+      if (connection != headers.end()) {
+        this->_keepAlive = connection->second.find("close") == std::string::npos;
+      }
+
+      int status = this->_response.status;
+      if (status >= 100 && status < 200) {  // interim response, the real one follows
+        this->_response = Response{};
+        return;
+      }
+
+      if (this->_resumeOffset > 0) {
+        if (status != 200 && status != 206) {
+          throw TransferException{"Unexpected status " + std::to_string(status) + " for resumed request"};
+        }
+        this->_skip = status == 200 ? this->_resumeOffset : 0;  // server ignored the range
+      }
+
+      auto encoding = headers.find(TRANSFER_ENCODING);
+      auto length   = headers.find(CONTENT_LENGTH);
+      if (this->_headRequest || status == 204 || status == 304) {
+        this->Complete();
+      } else if (encoding != headers.end() && encoding->second.find("chunked") != std::string::npos) {
+        this->_state = State::ChunkSize;
+      } else if (length != headers.end()) {
+        this->_remaining     = std::atol(length->second.c_str());  // NOLINT(cert-err34-c)
+        this->_response.size = int(this->_remaining);
+        if (!this->_onBody) {
+          this->_response.content.resize(this->_remaining - std::min<long>(this->_remaining, long(this->_skip)));
+        }
+        this->_state = State::Body;
+        if (this->_remaining == 0) this->Complete();
+      } else {
+        this->_remaining = -1;
+        this->_state     = State::Body;
+      }
+    }
+
+    auto FeedLine(const char* data, size_t size) -> size_t {
+      const char* lineEnd = static_cast<const char*>(std::memchr(data, '\n', size));
+      size_t used         = lineEnd ? size_t(lineEnd - data) + 1 : size;
+      this->_line.append(data, used);
+      if (!lineEnd) return used;
+
+      std::string line;
+      line.swap(this->_line);
+      if (line.size() >= 2 && line[line.size() - 2] == '\r') line.resize(line.size() - 2);
+
+      if (this->_state == State::ChunkSize) {
+        char* sizeEnd    = nullptr;
+        this->_remaining = std::strtol(line.c_str(), &sizeEnd, 16);
+        if (sizeEnd == line.c_str() || this->_remaining < 0) {
+          throw TransferException{"Malformed chunk size"};
+        }
+        this->_state = this->_remaining == 0 ? State::Trailer : State::ChunkData;
+      } else if (this->_state == State::ChunkEnd) {
+        if (!line.empty()) throw TransferException{"Malformed chunk"};
+        this->_state = State::ChunkSize;
+      } else if (line.empty()) {
+        this->Complete();
+      }
+      return used;
+    }
+
+    void Deliver(const char* data, size_t n) {
+      size_t skipped = std::min(n, this->_skip);
+      size_t kept    = n - skipped;
+      this->_skip -= skipped;
+
+      if (kept > 0) {
+        const char* from = data + skipped;
+        if (this->_onReceived) this->_onReceived(from, kept);
+        if (this->_onBody) {
+          this->_onBody(from, kept);
+        } else if (this->_state == State::Body && this->_remaining >= 0) {
+          std::memcpy(this->_response.content.data() + this->_received, from, kept);
         } else {
-          throw TransferException{"Unable to receive response bytes"};
+          this->_response.content.insert(this->_response.content.end(), from, from + kept);
         }
+        this->_received += kept;
+      }
+      this->Advance(n);
+    }
+
+    void Advance(size_t n) {
+      if (this->_remaining < 0) return;
+      this->_remaining -= long(n);
+      if (this->_remaining > 0) return;
+
+      if (this->_state == State::ChunkData) {
+        this->_state = State::ChunkEnd;
+      } else {
+        this->Complete();
       }
+    }
 
-      return buf;
+    void Complete() {
+      if (this->_response.size == 0) {
+        this->_response.size = int(this->_received);
+      }
+      this->_state = State::Done;
     }
 
-    auto parse_headers(const std::string& headline) {
-      Headers headers;
+    BodyCallback _onBody;
+    BodyCallback _onReceived;
+    bool _headRequest;
+    bool _keepAlive = true;
+    State _state    = State::Head;
+    long _remaining = 0;
+    size_t _received = 0;
+    size_t _resumeOffset = 0;
+    size_t _skip         = 0;
+    std::string _line;
+    Response _response;
+  };
 
-      int keyStart   = headline.find(CONTENT_LENGTH);
-      int valueStart = headline.find_first_not_of(": ", headline.find_first_of(':', keyStart));
-      int valueEnd   = headline.find_first_of(10, keyStart);
-      headers.emplace(CONTENT_LENGTH, headline.substr(valueStart, valueEnd - valueStart - 1));
+  /**
+   * Body kept across the attempts of a download. After a failed attempt Keep()
+   * takes over what was received; the next attempt asks for the rest with a
+   * Range header and its parser appends to the kept body. Callbacks given by
+   * the caller see every body byte exactly once, whichever way the server answers.
+   */
+  class Resume {
+  public:
+    explicit Resume(BodyCallback onBody = nullptr, BodyCallback onReceived = nullptr)
+        : _onBody(std::move(onBody)), _onReceived(std::move(onReceived)) {}
+
+    Resume(const Resume&) = delete;
+    auto operator=(const Resume&) -> Resume& = delete;
+
+    [[nodiscard]] auto Offset() const noexcept -> size_t {
+      return this->_offset;
+    }
 
+    /** @return request headers, asking for the missing bytes only once a part is kept */
+    [[nodiscard]] auto Apply(Headers headers) const -> Headers {
+      if (this->_offset > 0) {
+        headers.insert_or_assign("Range", "bytes=" + std::to_string(this->_offset) + "-");
+      }
       return headers;
     }
 
-    auto parse_response(const std::vector<char>& buffer) -> Response {
-      std::vector<char> headline_buffer;
-      std::vector<char> content_buffer;
+    auto NewParser(bool headRequest = false) -> std::unique_ptr<Parser> {
+      if (this->_offset == 0) {
+        return std::make_unique<Parser>(this->_onBody, headRequest, this->_onReceived);
+      }
+
+      BodyCallback append = this->_onBody;
+      if (!append) {
+        append = [this](const char* data, size_t size) {
+          this->_partial.content.insert(this->_partial.content.end(), data, data + size);
+        };
+      }
+      auto parser = std::make_unique<Parser>(append, headRequest, this->_onReceived);
+      parser->Resume(this->_offset);
+      return parser;
+    }
 
-      int i      = 3;
-      bool found = false;
-      for (; i < buffer.size(); i += 1) {
-        if (buffer[i - 3] == 13 && buffer[i - 1] == 13 && buffer[i - 2] == 10 && buffer[i] == 10) {
-          found = true;
-          break;
+    /**
+     * Keep the body received by a failed attempt
+     *
+     * @return false when the callbacks already saw bytes a new attempt cannot continue from
+     */
+    auto Keep(Parser& parser) -> bool {
+      if (this->_offset > 0) {
+        this->_offset += parser.Received();
+      } else if (parser.Received() == 0) {
+        return true;
+      } else if (parser.GetResponse().status == 200) {
+        this->_offset  = parser.Received();
+        this->_partial = parser.TakeResponse();
+        if (!this->_onBody) {
+          this->_partial.content.resize(this->_offset);
         }
+      } else {
+        return false;
       }
-      if (!found) {
-        throw TransferException("Malformed response");
+      return true;
+    }
+
+    /** @return the complete response once the parser of the last attempt is done */
+    auto Finish(Parser& parser) -> Response {
+      if (this->_offset == 0) {
+        return parser.TakeResponse();
       }
 
-      std::copy(&buffer[0], &buffer[i + 1], std::back_inserter(headline_buffer));
-      std::string headline(headline_buffer.begin(), headline_buffer.end());
-      Headers _headers   = parse_headers(headline);
-      int content_length = std::atoi(_headers.at(CONTENT_LENGTH).c_str());  // NOLINT(cert-err34-c)
+      this->_partial.status = 200;
+      this->_partial.size   = int(this->_offset + parser.Received());
+      return std::move(this->_partial);
+    }
+
+  private:
+    BodyCallback _onBody;
+    BodyCallback _onReceived;
+    size_t _offset = 0;
+    Response _partial;
+  };
 
-      std::copy(&buffer[i + 1], &buffer[i + 1 + content_length], std::back_inserter(content_buffer));
+  namespace {
+    /**
+     * Receive a single response. Known-length bodies are received straight into
+     * the response buffer, everything else goes through the shared receive buffer.
+     */
+    template<typename Receive>
+    void receive_response(Receive&& receive, Parser& parser, std::vector<char>& buffer, timeval* to,
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max()) {
+      using namespace std::chrono;
+
+      while (!parser.Done()) {
+        auto [window, windowSize] = parser.BodyWindow();
+        bool direct               = windowSize > 0;
+        char* target              = direct ? window : buffer.data();
+        int targetSize            = int(direct ? std::min<size_t>(windowSize, 1 << 30) : buffer.size());
+
+        timeval wait = *to;
+        if (deadline != steady_clock::time_point::max()) {
+          auto left = duration_cast<microseconds>(deadline - steady_clock::now()).count();
+          if (left <= 0) throw TransferException{"Timeout while receiving response"};
+          if (left < wait.tv_sec * 1000000L + wait.tv_usec) {
+            wait = timeval{.tv_sec = long(left / 1000000), .tv_usec = long(left % 1000000)};
+          }
+        }
+
+        auto receivedBytes = receive(target, targetSize, &wait);
+        if (receivedBytes > 0) {
+          if (direct) {
+            parser.Commit(receivedBytes);
+          } else if (parser.Feed(target, receivedBytes) < size_t(receivedBytes)) {
+            throw TransferException{"Unexpected bytes after response"};
+          }
+        } else if (receivedBytes == 0) {
+          parser.Finish();
+        } else if (receivedBytes == -2) {
+          throw TransferException{"Timeout while receiving response"};
+        } else {
+          throw TransferException{"Unable to receive response bytes"};
+        }
+      }
+    }
 
-      return Response{
-          .headers = _headers,
-          .content = content_buffer,
-          .size    = content_length};
+#ifdef NPMCI_TLS
+    /** receive_bytes() over TLS */
+    auto receive_tls(TlsStream& stream, Socket socket, char* buf, int len, timeval* to) -> int {
+      while (true) {
+        int receivedBytes = stream.Read(buf, size_t(len));
+        if (receivedBytes != TlsStream::kWouldBlock) return receivedBytes;
+        if (!wait_socket(socket, stream.WantsWrite(), to)) return -2;
+      }
     }
+#endif
   }  // namespace
 
-
   class Client {
   private:
     Socket socket = INVALID_SOCKET;  // NOLINT(hicpp-signed-bitwise)
+    std::vector<char> buffer = std::vector<char>(kReceiveBufferSize);
+#ifdef NPMCI_TLS
+    std::unique_ptr<TlsStream> stream;
+#endif
 
   protected:
-    std::string& _host;
-    short _port = 80;
-    Headers _headers{
-        {"Connection", "close"},
-        {"Accept", "*/*"},
-        {"User-Agent", "cpp-http/1.0"}};
+    std::string _host;
+    Origin _origin;
+    Resolver& _resolver;
+    TlsContext& _tls;
+    Headers _headers = default_headers();
+    RetryPolicy _retry;
     struct timeval timeout {
       .tv_sec  = 30,
       .tv_usec = 0
@@ -228,50 +717,234 @@ namespace http {
       return this->socket != INVALID_SOCKET;
     }  // NOLINT(hicpp-signed-bitwise)
 
-    void Close() const {
-      closeSocket(this->socket);
+    void Connect() {
+      auto addresses = this->_resolver.Resolve(this->_origin.host, this->_origin.port);
+      this->socket   = connect(addresses, &this->timeout);
+      if (this->_origin.secure) {
+        this->Handshake();
+      }
     }
 
-  public:
-    explicit Client(std::string& host)
-        : _host(host) {}
+    /** Set up TLS on the fresh connection, resuming an earlier session of the origin when possible */
+    void Handshake() {
+#ifdef NPMCI_TLS
+      this->stream = std::make_unique<TlsStream>(this->_tls, int(this->socket), this->_origin.host, this->_host);
 
-    auto Request(const std::string& method, const std::string& path) {
-      Response response;
-      try {
-        if (!this->isConnected()) {
-          this->socket = createSocket();
-          auto sa      = detectHost(this->_host, this->_port);
-          connect(this->socket, sa, &this->timeout);
+      int result;
+      while ((result = this->stream->Handshake()) == TlsStream::kWouldBlock) {
+        if (!wait_socket(this->socket, this->stream->WantsWrite(), &this->timeout)) {
+          throw ConnectionException{"Timeout during TLS handshake"};
         }
+      }
+      if (result < 0) {
+        throw ConnectionException{"TLS handshake failed: " + this->stream->Error()};
+      }
+#else
+      throw ConnectionException{"https is not supported by this build"};
+#endif
+    }
 
-        auto bytesWrote = send_request(this->socket, method, path, this->_host, this->_headers);
-        if (bytesWrote == 0) {
-          throw TransferException{"Unable to transfer request to source"};
+    void Send(const std::string& data) {
+      for (size_t sent = 0; sent < data.size();) {
+        int wrote;
+        bool wantsWrite = true;
+#ifdef NPMCI_TLS
+        if (this->stream) {
+          wrote      = this->stream->Write(data.data() + sent, data.size() - sent);
+          wantsWrite = this->stream->WantsWrite();
+        } else
+#endif
+        {
+          wrote = send_bytes(this->socket, data.data() + sent, data.size() - sent);
+          if (wrote < 0 && would_block()) wrote = -2;
         }
 
-        auto buffers = receive_response(this->socket, &this->timeout);
-        response     = parse_response(buffers);
+        if (wrote == -2 && wait_socket(this->socket, wantsWrite, &this->timeout)) continue;
+        if (wrote <= 0) throw ClosedException{"Unable to transfer request to source"};
+        sent += wrote;
+      }
+    }
+
+    auto Receive(char* buf, int len, timeval* to) -> int {
+#ifdef NPMCI_TLS
+      if (this->stream) return receive_tls(*this->stream, this->socket, buf, len, to);
+#endif
+      return receive_bytes(this->socket, buf, len, to);
+    }
 
-        this->Close();  //do not close if keepalived
-      } catch (std::exception& e) {
+    void Close() {
+#ifdef NPMCI_TLS
+      this->stream.reset();
+#endif
+      if (this->isConnected()) {
         closeSocket(this->socket);
-        throw e;
+        this->socket = INVALID_SOCKET;  // NOLINT(hicpp-signed-bitwise)
+      }
+    }
+
+    using Deadline = std::chrono::steady_clock::time_point;
+
+    void Exchange(const std::string& method, const std::string& path, const Headers& headers, Parser& parser, Deadline deadline) {
+      this->Send(build_request(method, path, this->_origin.authority, headers));
+
+      auto receive = [this](char* buf, int len, timeval* to) {
+        return this->Receive(buf, len, to);
+      };
+      receive_response(receive, parser, this->buffer, &this->timeout, deadline);
+      if (!parser.KeepAlive()) {
+        this->Close();
+      }
+    }
+
+    void Perform(const std::string& method, const std::string& path, const Headers& headers, Parser& parser, Deadline deadline = Deadline::max()) {
+      try {
+        bool reused = this->isConnected();
+        if (!reused) {
+          this->Connect();
+        }
+
+        try {
+          this->Exchange(method, path, headers, parser, deadline);
+        } catch (ClosedException&) {
+          // idle keep-alive connection was dropped by the server, retry once on a fresh one
+          if (!reused) throw;
+          this->Close();
+          this->Connect();
+          this->Exchange(method, path, headers, parser, deadline);
+        }
+      } catch (std::exception&) {
+        this->Close();
+        throw;
+      }
+    }
+
+  public:
+    /** @param host origin as "[https://]host[:port]" */
+    explicit Client(std::string host, Resolver& resolver = Resolver::Global(), TlsContext& tls = TlsContext::Global())
+        : _host(std::move(host)), _origin(parse_origin(this->_host)), _resolver(resolver), _tls(tls) {}
+
+    Client(const Client&) = delete;
+    auto operator=(const Client&) -> Client& = delete;
+
+    ~Client() {
+      this->Close();
+    }
+
+    [[nodiscard]] auto Host() const noexcept -> const std::string& {
+      return this->_host;
+    }
+
+    /**
+     * Perform a request on the persistent connection
+     *
+     * @param onBody optional callback receiving body slices as they arrive; the returned content stays empty
+     * @param onReceived optional callback observing body slices without taking them over
+     */
+    auto Request(const std::string& method, const std::string& path, const BodyCallback& onBody = nullptr, const BodyCallback& onReceived = nullptr) {
+      Parser parser{onBody, method == "HEAD", onReceived};
+      this->Perform(method, path, this->_headers, parser);
+      return parser.TakeResponse();
+    }
+
+    /**
+     * GET a body. After connection or transfer errors the download is retried
+     * with exponential backoff, asking only for the missing bytes.
+     */
+    auto Download(const std::string& path, const BodyCallback& onBody = nullptr, const BodyCallback& onReceived = nullptr) -> Response {
+      Resume resume{onBody, onReceived};
+      auto backoff = this->_retry.backoff;
+
+      for (int attempt = 1;; attempt++) {
+        auto parser = resume.NewParser();
+        try {
+          this->Perform("GET", path, resume.Apply(this->_headers), *parser, std::chrono::steady_clock::now() + this->_retry.attemptTimeout);
+          return resume.Finish(*parser);
+        } catch (const TransferException&) {
+          if (attempt >= this->_retry.attempts || !resume.Keep(*parser)) throw;
+        } catch (const ConnectionException&) {
+          if (attempt >= this->_retry.attempts || !resume.Keep(*parser)) throw;
+        }
+
+        std::this_thread::sleep_for(backoff);
+        backoff *= 2;
+      }
+    }
+
+    void Retry(const RetryPolicy& policy) {
+      this->_retry = policy;
+    }
+  };
+
+  /**
+   * Per-host pool of persistent connections. Workers check a client out with
+   * Acquire() and it is returned to the pool when the lease goes out of scope.
+   */
+  class Pool {
+  public:
+    class Lease {
+    public:
+      Lease(Pool* pool, std::unique_ptr<Client> client)
+          : _pool(pool), _client(std::move(client)) {}
+      Lease(Lease&&) noexcept = default;
+      Lease(const Lease&)     = delete;
+
+      ~Lease() {
+        if (this->_client) {
+          this->_pool->Release(std::move(this->_client));
+        }
+      }
+
+      auto operator->() const noexcept -> Client* {
+        return this->_client.get();
+      }
+
+    private:
+      Pool* _pool;
+      std::unique_ptr<Client> _client;
+    };
+
+    explicit Pool(size_t maxIdlePerHost = 16, Resolver& resolver = Resolver::Global(), TlsContext& tls = TlsContext::Global())
+        : _maxIdlePerHost(maxIdlePerHost), _resolver(resolver), _tls(tls) {}
+
+    auto Acquire(const std::string& host) -> Lease {
+      {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        auto& idle = this->_idle[host];
+        if (!idle.empty()) {
+          auto client = std::move(idle.back());
+          idle.pop_back();
+          return Lease{this, std::move(client)};
+        }
       }
 
-      return response;
+      return Lease{this, std::make_unique<Client>(host, this->_resolver, this->_tls)};
     }
 
-    auto Download(const std::string& path) {
-      return this->Request("GET", path);
+  private:
+    void Release(std::unique_ptr<Client> client) {
+      std::lock_guard<std::mutex> lock(this->_mutex);
+      auto& idle = this->_idle[client->Host()];
+      if (idle.size() < this->_maxIdlePerHost) {
+        idle.emplace_back(std::move(client));
+      }
     }
+
+    std::mutex _mutex;
+    std::map<std::string, std::vector<std::unique_ptr<Client>>> _idle;
+    size_t _maxIdlePerHost;
+    Resolver& _resolver;
+    TlsContext& _tls;
   };
 
 }  // namespace http
 
 #undef BUF_SIZE
+#undef CONNECTION
 #undef CONTENT_LENGTH
 #undef LE
+#undef TRANSFER_ENCODING
 #ifndef _WIN32
 #  undef INVALID_SOCKET
 #endif
+
+#endif  //NPM_HTTP_HPP
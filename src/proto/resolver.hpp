@@ -0,0 +1,193 @@
+#ifndef NPM_RESOLVER_HPP
+#define NPM_RESOLVER_HPP
+
+#include <cstring>
+#include <future>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#  include <winsock2.h>
+#  include <ws2tcpip.h>
+#else
+#  include <netdb.h>
+#  include <netinet/in.h>
+#  include <sys/socket.h>
+#endif
+
+namespace http {
+  struct Address {
+    sockaddr_storage storage{};
+    socklen_t length{};
+    int family{};
+
+    [[nodiscard]] auto Get() const noexcept -> const sockaddr* {
+      return reinterpret_cast<const sockaddr*>(&this->storage);
+    }
+
+    void SetPort(unsigned short port) {
+      if (this->family == AF_INET6) {
+        reinterpret_cast<sockaddr_in6*>(&this->storage)->sin6_port = htons(port);
+      } else {
+        reinterpret_cast<sockaddr_in*>(&this->storage)->sin_port = htons(port);
+      }
+    }
+  };
+
+  using Addresses = std::vector<Address>;
+
+  /** Initialize the socket library once; a no-op outside of Windows */
+  inline void startup() {
+#ifdef _WIN32
+    static bool started = []() {
+      WSADATA wsaData;
+      return WSAStartup(MAKEWORD(2, 2), &wsaData) == 0;  // NOLINT(hicpp-signed-bitwise)
+    }();
+    (void) started;
+#endif
+  }
+
+  class ResolveException : public std::runtime_error {
+  public:
+    using std::runtime_error::runtime_error;
+  };
+
+  /**
+   * Thread-safe host resolution cache. Every host is looked up once with
+   * getaddrinfo; concurrent callers for the same host wait on the same lookup.
+   * Results are ordered for Happy Eyeballs (RFC 8305): families interleaved,
+   * starting with the one getaddrinfo preferred.
+   *
+   * Hosts may be pre-seeded with address literals, e.g. to point the registry
+   * host at a local stand-in server.
+   */
+  class Resolver {
+  public:
+    using Hosts = std::map<std::string, std::vector<std::string>>;
+
+    explicit Resolver(const Hosts& hosts = {}) {
+      for (const auto& [host, literals] : hosts) {
+        this->Seed(host, literals);
+      }
+    }
+
+    static auto Global() -> Resolver& {
+      static Resolver resolver;
+      return resolver;
+    }
+
+    /** Pin a host to address literals; without any, the host is looked up normally again */
+    void Seed(const std::string& host, const std::vector<std::string>& literals) {
+      Addresses addresses;
+      for (const auto& literal : literals) {
+        auto parsed = lookup(literal, AI_NUMERICHOST);
+        addresses.insert(addresses.end(), parsed.begin(), parsed.end());
+      }
+
+      std::lock_guard<std::mutex> lock(this->_mutex);
+      if (addresses.empty()) {  // an empty entry would leave nothing to connect to
+        this->_cache.erase(host);
+        return;
+      }
+
+      std::promise<Addresses> seeded;
+      seeded.set_value(interleave(addresses));
+      this->_cache.insert_or_assign(host, seeded.get_future().share());
+    }
+
+    /** @return resolved addresses with the port applied, in connection attempt order */
+    auto Resolve(const std::string& host, unsigned short port) -> Addresses {
+      std::shared_future<Addresses> entry;
+      std::promise<Addresses> lookupPromise;
+      bool owner = false;
+
+      {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        auto found = this->_cache.find(host);
+        if (found != this->_cache.end()) {
+          entry = found->second;
+        } else {
+          entry = lookupPromise.get_future().share();
+          this->_cache.emplace(host, entry);
+          owner = true;
+        }
+      }
+
+      if (owner) {
+        try {
+          lookupPromise.set_value(interleave(lookup(host, AI_ADDRCONFIG)));
+        } catch (...) {
+          {  // do not cache failures, the next caller retries the lookup
+            std::lock_guard<std::mutex> lock(this->_mutex);
+            this->_cache.erase(host);
+          }
+          lookupPromise.set_exception(std::current_exception());
+        }
+      }
+
+      Addresses addresses = entry.get();
+      for (auto& address : addresses) {
+        address.SetPort(port);
+      }
+      return addresses;
+    }
+
+  private:
+    static auto lookup(const std::string& host, int flags) -> Addresses {
+      addrinfo hints{};
+      hints.ai_family   = AF_UNSPEC;
+      hints.ai_socktype = SOCK_STREAM;
+      hints.ai_protocol = IPPROTO_TCP;
+      hints.ai_flags    = flags;
+
+      startup();
+
+      addrinfo* result = nullptr;
+      if (::getaddrinfo(host.c_str(), nullptr, &hints, &result) != 0 || result == nullptr) {
+        throw ResolveException{"Unable to resolve host '" + host + "'"};
+      }
+
+      Addresses addresses;
+      for (addrinfo* i = result; i != nullptr; i = i->ai_next) {
+        if (i->ai_family != AF_INET && i->ai_family != AF_INET6) continue;
+
+        Address address;
+        address.family = i->ai_family;
+        address.length = socklen_t(i->ai_addrlen);
+        std::memcpy(&address.storage, i->ai_addr, i->ai_addrlen);
+        addresses.emplace_back(address);
+      }
+      ::freeaddrinfo(result);
+
+      if (addresses.empty()) {
+        throw ResolveException{"No usable address for host '" + host + "'"};
+      }
+      return addresses;
+    }
+
+    static auto interleave(const Addresses& addresses) -> Addresses {
+      if (addresses.empty()) return addresses;
+
+      Addresses preferred;
+      Addresses other;
+      for (const auto& address : addresses) {
+        (address.family == addresses.front().family ? preferred : other).emplace_back(address);
+      }
+
+      Addresses ordered;
+      for (size_t i = 0; i < preferred.size() || i < other.size(); i++) {
+        if (i < preferred.size()) ordered.emplace_back(preferred[i]);
+        if (i < other.size()) ordered.emplace_back(other[i]);
+      }
+      return ordered;
+    }
+
+    std::mutex _mutex;
+    std::map<std::string, std::shared_future<Addresses>> _cache;
+  };
+}  // namespace http
+
+#endif  //NPM_RESOLVER_HPP
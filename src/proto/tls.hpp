@@ -0,0 +1,220 @@
+#ifndef NPM_TLS_HPP
+#define NPM_TLS_HPP
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+
+#ifdef NPMCI_TLS
+#  include <openssl/err.h>
+#  include <openssl/pem.h>
+#  include <openssl/ssl.h>
+#  include <openssl/x509v3.h>
+#endif
+
+namespace http {
+  class TlsException : public std::runtime_error {
+  public:
+    using std::runtime_error::runtime_error;
+  };
+
+#ifdef NPMCI_TLS
+  /**
+   * Client side TLS configuration shared by every connection: certificate
+   * verification against the system store plus certificates added with Trust(),
+   * and a per-origin session cache so later connections resume the session
+   * instead of paying for a full handshake.
+   */
+  class TlsContext {
+  public:
+    TlsContext() {
+      this->_context = ::SSL_CTX_new(::TLS_client_method());
+      if (!this->_context) {
+        throw TlsException{"Unable to create TLS context"};
+      }
+
+      SSL_CTX_set_min_proto_version(this->_context, TLS1_2_VERSION);
+      ::SSL_CTX_set_default_verify_paths(this->_context);
+      ::SSL_CTX_set_verify(this->_context, SSL_VERIFY_PEER, nullptr);
+      SSL_CTX_set_mode(this->_context, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+#  ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+      // registries often close without close_notify; truncation is caught by HTTP framing instead
+      ::SSL_CTX_set_options(this->_context, SSL_OP_IGNORE_UNEXPECTED_EOF);
+#  endif
+
+      // sessions are kept per origin by Remember(), TLS 1.3 tickets arrive after the handshake
+      SSL_CTX_set_session_cache_mode(this->_context, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+      SSL_CTX_set_app_data(this->_context, this);
+      ::SSL_CTX_sess_set_new_cb(this->_context, [](SSL* ssl, SSL_SESSION* session) -> int {
+        auto* context = static_cast<TlsContext*>(SSL_CTX_get_app_data(::SSL_get_SSL_CTX(ssl)));
+        auto* origin  = static_cast<const std::string*>(SSL_get_app_data(ssl));
+        if (!context || !origin) return 0;
+        context->Remember(*origin, session);
+        return 1;
+      });
+    }
+
+    TlsContext(const TlsContext&) = delete;
+    auto operator=(const TlsContext&) -> TlsContext& = delete;
+
+    ~TlsContext() {
+      for (auto& [origin, session] : this->_sessions) {
+        ::SSL_SESSION_free(session);
+      }
+      ::SSL_CTX_free(this->_context);
+    }
+
+    static auto Global() -> TlsContext& {
+      static TlsContext context;
+      return context;
+    }
+
+    /** Trust an additional certificate, e.g. the self-signed one of a local stand-in registry */
+    void Trust(const std::string& pem) {
+      std::unique_ptr<BIO, decltype(&::BIO_free)> bio(::BIO_new_mem_buf(pem.data(), int(pem.size())), &::BIO_free);
+      X509* certificate = ::PEM_read_bio_X509(bio.get(), nullptr, nullptr, nullptr);
+      if (!certificate) {
+        throw TlsException{"Unable to parse certificate"};
+      }
+      ::X509_STORE_add_cert(::SSL_CTX_get_cert_store(this->_context), certificate);
+      ::X509_free(certificate);
+    }
+
+    [[nodiscard]] auto Handle() const noexcept -> SSL_CTX* {
+      return this->_context;
+    }
+
+    /** @return a new reference to the last session of the origin, nullptr if there is none */
+    auto Session(const std::string& origin) -> SSL_SESSION* {
+      std::lock_guard<std::mutex> lock(this->_mutex);
+      auto found = this->_sessions.find(origin);
+      if (found == this->_sessions.end()) return nullptr;
+      ::SSL_SESSION_up_ref(found->second);
+      return found->second;
+    }
+
+    /** Keep a session for the origin, taking over the reference */
+    void Remember(const std::string& origin, SSL_SESSION* session) {
+      std::lock_guard<std::mutex> lock(this->_mutex);
+      auto& slot = this->_sessions[origin];
+      if (slot) ::SSL_SESSION_free(slot);
+      slot = session;
+    }
+
+  private:
+    SSL_CTX* _context = nullptr;
+    std::mutex _mutex;
+    std::map<std::string, SSL_SESSION*> _sessions;
+  };
+
+  /**
+   * TLS on top of a connected non-blocking socket. Operations never block:
+   * they return kWouldBlock and WantsWrite() tells which readiness to wait for.
+   */
+  class TlsStream {
+  public:
+    static constexpr int kWouldBlock = -2;
+
+    TlsStream(TlsContext& context, int socket, const std::string& host, std::string origin)
+        : _origin(std::move(origin)) {
+      this->_ssl = ::SSL_new(context.Handle());
+      if (!this->_ssl) {
+        throw TlsException{"Unable to create TLS connection"};
+      }
+
+      ::SSL_set_fd(this->_ssl, socket);
+      ::SSL_set_connect_state(this->_ssl);
+      SSL_set_app_data(this->_ssl, &this->_origin);
+      SSL_set_tlsext_host_name(this->_ssl, host.c_str());
+      ::SSL_set1_host(this->_ssl, host.c_str());
+
+      if (SSL_SESSION* session = context.Session(this->_origin)) {
+        ::SSL_set_session(this->_ssl, session);
+        ::SSL_SESSION_free(session);
+      }
+    }
+
+    TlsStream(const TlsStream&) = delete;
+    auto operator=(const TlsStream&) -> TlsStream& = delete;
+
+    ~TlsStream() {
+      // connections are dropped without close_notify; unless they failed, their
+      // sessions must stay resumable, which SSL_free only allows after a shutdown
+      if (!this->_error) ::SSL_set_shutdown(this->_ssl, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+      ::SSL_free(this->_ssl);
+    }
+
+    /** @return 1 once the handshake is complete, kWouldBlock or -1 on failure */
+    auto Handshake() -> int {
+      int result = ::SSL_do_handshake(this->_ssl);
+      return result == 1 ? 1 : this->Failed(result);
+    }
+
+    /** @return bytes read, 0 on orderly shutdown, kWouldBlock or -1 on failure */
+    auto Read(char* buffer, size_t size) -> int {
+      size_t read = 0;
+      int result  = ::SSL_read_ex(this->_ssl, buffer, size, &read);
+      if (result == 1) return int(read);
+      if (::SSL_get_error(this->_ssl, result) == SSL_ERROR_ZERO_RETURN) return 0;
+      return this->Failed(result);
+    }
+
+    /** @return bytes written, kWouldBlock or -1 on failure */
+    auto Write(const char* data, size_t size) -> int {
+      size_t written = 0;
+      int result     = ::SSL_write_ex(this->_ssl, data, size, &written);
+      return result == 1 ? int(written) : this->Failed(result);
+    }
+
+    [[nodiscard]] auto WantsWrite() const noexcept -> bool {
+      return this->_wantsWrite;
+    }
+
+    [[nodiscard]] auto Resumed() const noexcept -> bool {
+      return ::SSL_session_reused(this->_ssl) == 1;
+    }
+
+    /** @return description of the last failure */
+    [[nodiscard]] auto Error() const -> std::string {
+      long verify = ::SSL_get_verify_result(this->_ssl);
+      if (verify != X509_V_OK) {
+        return std::string("certificate verification failed: ") + ::X509_verify_cert_error_string(verify);
+      }
+      char message[256] = "TLS failure";
+      if (this->_error > 1) ::ERR_error_string_n(this->_error, message, sizeof(message));
+      return message;
+    }
+
+  private:
+    auto Failed(int result) -> int {
+      int error = ::SSL_get_error(this->_ssl, result);
+      if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE) {
+        this->_wantsWrite = error == SSL_ERROR_WANT_WRITE;
+        return kWouldBlock;
+      }
+      this->_error = std::max(::ERR_get_error(), 1UL);
+      ::ERR_clear_error();
+      return -1;
+    }
+
+    SSL* _ssl = nullptr;
+    std::string _origin;
+    bool _wantsWrite     = false;
+    unsigned long _error = 0;
+  };
+#else
+  /** Placeholder when built without TLS support; https origins are rejected */
+  class TlsContext {
+  public:
+    static auto Global() -> TlsContext& {
+      static TlsContext context;
+      return context;
+    }
+  };
+#endif
+}  // namespace http
+
+#endif  //NPM_TLS_HPP
@@ -0,0 +1,137 @@
+#ifndef NPM_BUFFER_POOL_HPP
+#define NPM_BUFFER_POOL_HPP
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace buffers {
+  /**
+   * Size-classed pool of byte buffers shared by the workers of one install.
+   * Capacities grow in quarter steps between powers of two, so a buffer is at
+   * most a quarter larger than asked for. Released buffers are kept for reuse
+   * up to maxIdleBytes; anything beyond that is freed right away.
+   */
+  class Pool {
+  public:
+    /** Buffer on loan from the pool, handed back when destroyed */
+    class Buffer {
+    public:
+      Buffer() = default;
+      Buffer(Buffer&& other) noexcept
+          : _pool(other._pool), _data(std::move(other._data)), _size(other._size), _capacity(other._capacity) {
+        other._pool     = nullptr;
+        other._size     = 0;
+        other._capacity = 0;
+      }
+
+      auto operator=(Buffer&& other) noexcept -> Buffer& {
+        if (this != &other) {
+          this->Release();
+          std::swap(this->_pool, other._pool);
+          std::swap(this->_data, other._data);
+          std::swap(this->_size, other._size);
+          std::swap(this->_capacity, other._capacity);
+        }
+        return *this;
+      }
+
+      ~Buffer() {
+        this->Release();
+      }
+
+      [[nodiscard]] auto Data() const noexcept -> unsigned char* {
+        return this->_data.get();
+      }
+
+      [[nodiscard]] auto Size() const noexcept -> size_t {
+        return this->_size;
+      }
+
+      [[nodiscard]] auto Capacity() const noexcept -> size_t {
+        return this->_capacity;
+      }
+
+      /** @param size new size, at most Capacity() */
+      void Resize(size_t size) noexcept {
+        this->_size = size;
+      }
+
+      /** Hand the memory back to the pool early */
+      void Release() {
+        if (this->_pool && this->_data) this->_pool->Return(std::move(this->_data), this->_capacity);
+        this->_pool     = nullptr;
+        this->_size     = 0;
+        this->_capacity = 0;
+      }
+
+    private:
+      friend class Pool;
+      Buffer(Pool* pool, std::unique_ptr<unsigned char[]> data, size_t size, size_t capacity)
+          : _pool(pool), _data(std::move(data)), _size(size), _capacity(capacity) {}
+
+      Pool* _pool = nullptr;
+      std::unique_ptr<unsigned char[]> _data;
+      size_t _size     = 0;
+      size_t _capacity = 0;
+    };
+
+    explicit Pool(size_t maxIdleBytes = size_t(64) << 20U)
+        : _maxIdleBytes(maxIdleBytes) {}
+
+    Pool(const Pool&) = delete;
+    auto operator=(const Pool&) -> Pool& = delete;
+
+    /** @return a buffer of size bytes; its content is uninitialised */
+    auto Acquire(size_t size) -> Buffer {
+      size_t capacity = Capacity(size);
+      {
+        std::lock_guard<std::mutex> lock(this->_mutex);
+        auto found = this->_idle.find(capacity);
+        if (found != this->_idle.end() && !found->second.empty()) {
+          auto data = std::move(found->second.back());
+          found->second.pop_back();
+          this->_idleBytes -= capacity;
+          return Buffer(this, std::move(data), size, capacity);
+        }
+      }
+      return Buffer(this, std::unique_ptr<unsigned char[]>(new unsigned char[capacity]), size, capacity);
+    }
+
+    [[nodiscard]] auto IdleBytes() const -> size_t {
+      std::lock_guard<std::mutex> lock(this->_mutex);
+      return this->_idleBytes;
+    }
+
+    /** @return capacity of the size class holding size bytes */
+    static auto Capacity(size_t size) -> size_t {
+      size_t power = kMinCapacity;
+      while (power < size) power <<= 1U;
+      if (power == kMinCapacity) return power;
+
+      size_t step     = power / 8;  // power / 2 .. power in quarters
+      size_t capacity = power / 2;
+      while (capacity < size) capacity += step;
+      return capacity;
+    }
+
+  private:
+    static constexpr size_t kMinCapacity = 64 * 1024;
+
+    void Return(std::unique_ptr<unsigned char[]> data, size_t capacity) {
+      std::lock_guard<std::mutex> lock(this->_mutex);
+      if (this->_idleBytes + capacity > this->_maxIdleBytes) return;
+      this->_idle[capacity].emplace_back(std::move(data));
+      this->_idleBytes += capacity;
+    }
+
+    size_t _maxIdleBytes;
+    mutable std::mutex _mutex;
+    std::map<size_t, std::vector<std::unique_ptr<unsigned char[]>>> _idle;
+    size_t _idleBytes = 0;
+  };
+}  // namespace buffers
+
+#endif  //NPM_BUFFER_POOL_HPP
@@ -0,0 +1,200 @@
+#ifndef NPM_CACHE_HPP
+#define NPM_CACHE_HPP
+
+#include "fs.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace cache {
+  namespace {
+    /** @return lowercase hex of a base64 string, empty if it is not valid base64 */
+    auto base64_to_hex(const std::string& source) -> std::string {
+      static const std::string alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+      static const char* digits         = "0123456789abcdef";
+
+      std::string hex;
+      unsigned int buffer = 0;
+      int bits            = 0;
+
+      for (char c : source) {
+        if (c == '=') break;
+        auto value = alphabet.find(c);
+        if (value == std::string::npos) return "";
+
+        buffer = (buffer << 6U) | unsigned(value);
+        bits += 6;
+        if (bits >= 8) {
+          bits -= 8;
+          auto byte = (buffer >> unsigned(bits)) & 0xFFU;
+          hex += digits[byte >> 4U];
+          hex += digits[byte & 0xFU];
+        }
+      }
+      return hex;
+    }
+
+    /** Replace a file through a private temporary file, so readers never see it half written */
+    void replace_file(const std::string& path, const char* data, size_t size) {
+      fs::create_dir(path, false);
+      auto temporary = path + "." + std::to_string(std::random_device{}()) + ".tmp";
+
+      std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+      if (!out.is_open()) {
+        throw fs::FileException("Unable to write '" + temporary + "'");
+      }
+      out.write(data, std::streamsize(size));
+      out.close();
+
+#ifdef _WIN32
+      std::remove(path.c_str());  // rename does not replace existing files on Windows
+#endif
+      if (!out || std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        throw fs::FileException("Unable to write '" + path + "'");
+      }
+    }
+  }  // namespace
+
+  /**
+   * Content-addressable tarball store. Entries are keyed by the SRI integrity
+   * string of the lockfile ("sha512-<base64>") and live at
+   * <root>/<algorithm>/<hex[0..2]>/<hex[2..]>, so identical tarballs are stored
+   * once no matter which package or registry they were resolved from.
+   */
+  class Store {
+  public:
+    explicit Store(std::string root)
+        : _root(std::move(root)) {}
+
+    [[nodiscard]] auto Root() const noexcept -> const std::string& {
+      return this->_root;
+    }
+
+    /** $NPMCI_CACHE, falling back to a per-user cache directory */
+    static auto DefaultRoot() -> std::string {
+      if (const char* dir = std::getenv("NPMCI_CACHE")) return dir;
+#ifdef _WIN32
+      if (const char* dir = std::getenv("LOCALAPPDATA")) return std::string(dir) + "/npmci/cache";
+#else
+      if (const char* dir = std::getenv("XDG_CACHE_HOME")) return std::string(dir) + "/npmci";
+      if (const char* dir = std::getenv("HOME")) return std::string(dir) + "/.cache/npmci";
+#endif
+      return ".npmci-cache";
+    }
+
+    /** @return location of the entry, empty if the integrity string cannot be used as a key */
+    [[nodiscard]] auto Path(const std::string& integrity) const -> std::string {
+      // several space separated hashes are allowed, the first one is the key
+      auto first = integrity.substr(0, integrity.find(' '));
+      auto dash  = first.find('-');
+      if (dash == std::string::npos) return "";
+
+      auto algorithm = first.substr(0, dash);
+      size_t bytes   = algorithm == "sha512" ? 64 : algorithm == "sha1" ? 20 : 0;
+      if (bytes == 0) return "";
+
+      // only a padded digest of the algorithm's size, so no key escapes the store or aliases another
+      auto digest = first.substr(dash + 1, first.find('?') - dash - 1);  // drop SRI options
+      if (digest.size() != (bytes + 2) / 3 * 4) return "";
+      auto hex = base64_to_hex(digest);
+      if (hex.size() != bytes * 2) return "";
+
+      return this->_root + "/" + algorithm + "/" + hex.substr(0, 2) + "/" + hex.substr(2);
+    }
+
+    /** Read a cached tarball into content, @return whether the entry exists */
+    auto Read(const std::string& integrity, std::vector<char>& content) const -> bool {
+      auto path = this->Path(integrity);
+      if (path.empty()) return false;
+
+      std::ifstream in(path, std::ios::binary | std::ios::ate);
+      if (!in.is_open()) return false;
+
+      auto size = std::streamsize(in.tellg());
+      content.resize(size_t(size));
+      in.seekg(0);
+      return bool(in.read(content.data(), size));
+    }
+
+    /** Evict an entry, e.g. one that no longer matches its integrity */
+    void Remove(const std::string& integrity) const {
+      auto path = this->Path(integrity);
+      if (!path.empty()) std::remove(path.c_str());
+    }
+
+    /**
+     * Store a tarball. The entry is written to a private temporary file and
+     * renamed into place, so concurrent installs never observe partial entries.
+     */
+    void Write(const std::string& integrity, const std::vector<char>& content) const {
+      auto path = this->Path(integrity);
+      if (path.empty()) return;
+
+      replace_file(path, content.data(), content.size());
+    }
+
+  private:
+    std::string _root;
+  };
+
+  /**
+   * Tarball sizes seen by earlier installs, kept as "<bytes> <url>" lines so
+   * the next install can start the largest downloads first. Thread-safe.
+   */
+  class Sizes {
+  public:
+    /** @param path table file; an empty path keeps the table in memory only */
+    explicit Sizes(std::string path = "")
+        : _path(std::move(path)) {
+      if (this->_path.empty()) return;
+
+      std::istringstream lines(fs::read_file(this->_path));
+      size_t size;
+      std::string url;
+      while (lines >> size >> url) {
+        this->_sizes[url] = size;
+      }
+    }
+
+    /** @return recorded size in bytes, 0 when unknown */
+    auto Get(const std::string& url) const -> size_t {
+      std::lock_guard<std::mutex> lock(this->_mutex);
+      auto found = this->_sizes.find(url);
+      return found == this->_sizes.end() ? 0 : found->second;
+    }
+
+    void Record(const std::string& url, size_t size) {
+      std::lock_guard<std::mutex> lock(this->_mutex);
+      auto& recorded = this->_sizes[url];
+      this->_changed |= recorded != size;
+      recorded = size;
+    }
+
+    void Save() {
+      std::lock_guard<std::mutex> lock(this->_mutex);
+      if (this->_path.empty() || !this->_changed) return;
+
+      std::string content;
+      for (const auto& [url, size] : this->_sizes) {
+        content.append(std::to_string(size)).append(" ").append(url).append("\n");
+      }
+      replace_file(this->_path, content.data(), content.size());
+      this->_changed = false;
+    }
+
+  private:
+    std::string _path;
+    mutable std::mutex _mutex;
+    std::map<std::string, size_t> _sizes;
+    bool _changed = false;
+  };
+}  // namespace cache
+
+#endif  //NPM_CACHE_HPP
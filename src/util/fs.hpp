@@ -1,6 +1,16 @@
+#ifndef NPM_FS_HPP
+#define NPM_FS_HPP
+
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
 #include <map>
+#include <mutex>
 #include <regex>
+#include <set>
+#include <shared_mutex>
 #include <string>
+#include <string_view>
 #include <sys/stat.h>  // stat
 #include <vector>
 #if defined(_WIN32)
@@ -83,6 +93,81 @@ namespace fs {
     }
   }
 
+  /**
+   * Directories known to exist during one install, shared by the workers
+   * extracting into them. A path is checked against the set from its deepest
+   * directory up, and only the directories missing below the first known one
+   * are created, each once; almost every file lands in a directory some
+   * earlier file already needed, which then costs a lookup under a shared lock
+   * instead of a failing mkdir per ancestor.
+   */
+  class Directories {
+  public:
+    /**
+     * Create the directories of path
+     *
+     * @param createLast whether the last component is a directory too, rather than a file
+     */
+    void Create(std::string_view path, bool createLast) {
+      while (createLast && path.size() > 1 && path.back() == '/') path.remove_suffix(1);
+      size_t end = createLast ? path.size() : path.rfind('/');
+      if (end == std::string_view::npos || end == 0) return;
+
+      // directories still to create, deepest first
+      std::vector<size_t> missing;
+      {
+        std::shared_lock<std::shared_mutex> lock(this->_mutex);
+        for (size_t pos = end; pos != std::string_view::npos && pos > 0; pos = path.rfind('/', pos - 1)) {
+          if (this->_known.count(path.substr(0, pos))) break;
+          missing.push_back(pos);
+        }
+      }
+      if (missing.empty()) return;
+
+      std::vector<std::string> created;
+      for (auto it = missing.rbegin(); it != missing.rend(); ++it) {
+        std::string directory(path.substr(0, *it));
+#if defined(_WIN32)
+        int result = _mkdir(directory.c_str());
+#else
+        int result = mkdir(directory.c_str(), 0755);
+#endif
+        if (result != 0 && errno != EEXIST) break;  // the rest cannot be created either, try again next time
+        created.emplace_back(std::move(directory));
+      }
+
+      std::unique_lock<std::shared_mutex> lock(this->_mutex);
+      for (auto& directory : created) this->_known.insert(std::move(directory));
+    }
+
+  private:
+    std::shared_mutex _mutex;
+    std::set<std::string, std::less<>> _known;
+  };
+
+  /**
+   * Write a file in one unbuffered write, replacing it if it exists
+   *
+   * @return false if the file cannot be created or written
+   */
+  auto write_file(const std::string& path, const char* data, size_t size) -> bool {
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) {
+      return false;
+    }
+
+    std::setvbuf(file, nullptr, _IONBF, 0);
+    bool written = std::fwrite(data, 1, size, file) == size;
+    return std::fclose(file) == 0 && written;
+  }
+
+  /** Make a file executable by anyone who may read it, like tar does for executable entries; nothing on Windows */
+  void set_executable(const std::string& path) {
+#if !defined(_WIN32)
+    chmod(path.c_str(), 0755);
+#endif
+  }
+
   auto read_file(const std::string& path, bool should_exist = false) -> std::string {
     std::ifstream i(path);
     if (!i.is_open()) {
@@ -110,3 +195,5 @@ namespace fs {
   }
 
 }  // namespace fs
+
+#endif  //NPM_FS_HPP
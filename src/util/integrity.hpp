@@ -0,0 +1,221 @@
+#ifndef NPM_INTEGRITY_HPP
+#define NPM_INTEGRITY_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace integrity {
+  class IntegrityException : public std::runtime_error {
+  public:
+    using std::runtime_error::runtime_error;
+  };
+
+  /**
+   * Incremental SHA-512 (FIPS 180-4). Bytes are hashed straight from the
+   * caller's buffer a block at a time; only a partial trailing block is copied.
+   */
+  class Sha512 {
+  public:
+    using Digest = std::array<unsigned char, 64>;
+
+    void Update(const void* data, size_t size) {
+      const auto* bytes = static_cast<const unsigned char*>(data);
+      this->_length += size;
+
+      if (this->_buffered > 0) {
+        size_t n = std::min(size, kBlockSize - this->_buffered);
+        std::memcpy(this->_block + this->_buffered, bytes, n);
+        this->_buffered += n;
+        bytes += n;
+        size -= n;
+        if (this->_buffered < kBlockSize) return;
+        this->Compress(this->_block);
+        this->_buffered = 0;
+      }
+
+      for (; size >= kBlockSize; bytes += kBlockSize, size -= kBlockSize) {
+        this->Compress(bytes);
+      }
+
+      std::memcpy(this->_block, bytes, size);
+      this->_buffered = size;
+    }
+
+    auto Final() -> Digest {
+      uint64_t bits = this->_length * 8;
+
+      this->_block[this->_buffered++] = 0x80;
+      if (this->_buffered > kBlockSize - 16) {
+        std::memset(this->_block + this->_buffered, 0, kBlockSize - this->_buffered);
+        this->Compress(this->_block);
+        this->_buffered = 0;
+      }
+      std::memset(this->_block + this->_buffered, 0, kBlockSize - 8 - this->_buffered);
+      for (int i = 0; i < 8; i++) {
+        this->_block[kBlockSize - 1 - i] = (unsigned char) (bits >> (8U * unsigned(i)));
+      }
+      this->Compress(this->_block);
+
+      Digest digest{};
+      for (size_t i = 0; i < 64; i++) {
+        digest[i] = (unsigned char) (this->_state[i / 8] >> (56U - 8U * (i % 8)));
+      }
+      return digest;
+    }
+
+  private:
+    static constexpr size_t kBlockSize = 128;
+
+    static constexpr uint64_t kRound[80] = {
+        0x428a2f98d728ae22, 0x7137449123ef65cd, 0xb5c0fbcfec4d3b2f, 0xe9b5dba58189dbbc, 0x3956c25bf348b538,
+        0x59f111f1b605d019, 0x923f82a4af194f9b, 0xab1c5ed5da6d8118, 0xd807aa98a3030242, 0x12835b0145706fbe,
+        0x243185be4ee4b28c, 0x550c7dc3d5ffb4e2, 0x72be5d74f27b896f, 0x80deb1fe3b1696b1, 0x9bdc06a725c71235,
+        0xc19bf174cf692694, 0xe49b69c19ef14ad2, 0xefbe4786384f25e3, 0x0fc19dc68b8cd5b5, 0x240ca1cc77ac9c65,
+        0x2de92c6f592b0275, 0x4a7484aa6ea6e483, 0x5cb0a9dcbd41fbd4, 0x76f988da831153b5, 0x983e5152ee66dfab,
+        0xa831c66d2db43210, 0xb00327c898fb213f, 0xbf597fc7beef0ee4, 0xc6e00bf33da88fc2, 0xd5a79147930aa725,
+        0x06ca6351e003826f, 0x142929670a0e6e70, 0x27b70a8546d22ffc, 0x2e1b21385c26c926, 0x4d2c6dfc5ac42aed,
+        0x53380d139d95b3df, 0x650a73548baf63de, 0x766a0abb3c77b2a8, 0x81c2c92e47edaee6, 0x92722c851482353b,
+        0xa2bfe8a14cf10364, 0xa81a664bbc423001, 0xc24b8b70d0f89791, 0xc76c51a30654be30, 0xd192e819d6ef5218,
+        0xd69906245565a910, 0xf40e35855771202a, 0x106aa07032bbd1b8, 0x19a4c116b8d2d0c8, 0x1e376c085141ab53,
+        0x2748774cdf8eeb99, 0x34b0bcb5e19b48a8, 0x391c0cb3c5c95a63, 0x4ed8aa4ae3418acb, 0x5b9cca4f7763e373,
+        0x682e6ff3d6b2b8a3, 0x748f82ee5defb2fc, 0x78a5636f43172f60, 0x84c87814a1f0ab72, 0x8cc702081a6439ec,
+        0x90befffa23631e28, 0xa4506cebde82bde9, 0xbef9a3f7b2c67915, 0xc67178f2e372532b, 0xca273eceea26619c,
+        0xd186b8c721c0c207, 0xeada7dd6cde0eb1e, 0xf57d4f7fee6ed178, 0x06f067aa72176fba, 0x0a637dc5a2c898a6,
+        0x113f9804bef90dae, 0x1b710b35131c471b, 0x28db77f523047d84, 0x32caab7b40c72493, 0x3c9ebe0a15c9bebc,
+        0x431d67c49c100d4c, 0x4cc5d4becb3e42b6, 0x597f299cfc657e2a, 0x5fcb6fab3ad6faec, 0x6c44198c4a475817};
+
+    static constexpr auto rotr(uint64_t x, unsigned n) -> uint64_t {
+      return (x >> n) | (x << (64U - n));
+    }
+
+    static auto load(const unsigned char* p) -> uint64_t {
+      uint64_t v;
+      std::memcpy(&v, p, 8);
+#if defined(__GNUC__) || defined(__clang__)
+      return __builtin_bswap64(v);
+#else
+      v = ((v & 0x00000000FFFFFFFFULL) << 32U) | ((v & 0xFFFFFFFF00000000ULL) >> 32U);
+      v = ((v & 0x0000FFFF0000FFFFULL) << 16U) | ((v & 0xFFFF0000FFFF0000ULL) >> 16U);
+      return ((v & 0x00FF00FF00FF00FFULL) << 8U) | ((v & 0xFF00FF00FF00FF00ULL) >> 8U);
+#endif
+    }
+
+    /** One 128 byte block; the message schedule is kept in a rolling 16 word window */
+    void Compress(const unsigned char* block) {
+      uint64_t w[16];
+      for (int i = 0; i < 16; i++) {
+        w[i] = load(block + 8 * i);
+      }
+
+      uint64_t a = this->_state[0], b = this->_state[1], c = this->_state[2], d = this->_state[3];
+      uint64_t e = this->_state[4], f = this->_state[5], g = this->_state[6], h = this->_state[7];
+
+      for (int i = 0; i < 80; i++) {
+        if (i >= 16) {
+          uint64_t w15 = w[(i - 15) & 15U];
+          uint64_t w2  = w[(i - 2) & 15U];
+          uint64_t s0  = rotr(w15, 1) ^ rotr(w15, 8) ^ (w15 >> 7U);
+          uint64_t s1  = rotr(w2, 19) ^ rotr(w2, 61) ^ (w2 >> 6U);
+          w[i & 15U] += s0 + w[(i - 7) & 15U] + s1;
+        }
+
+        uint64_t t1 = h + (rotr(e, 14) ^ rotr(e, 18) ^ rotr(e, 41)) + ((e & f) ^ (~e & g)) + kRound[i] + w[i & 15U];
+        uint64_t t2 = (rotr(a, 28) ^ rotr(a, 34) ^ rotr(a, 39)) + ((a & b) ^ (a & c) ^ (b & c));
+        h           = g;
+        g           = f;
+        f           = e;
+        e           = d + t1;
+        d           = c;
+        c           = b;
+        b           = a;
+        a           = t1 + t2;
+      }
+
+      this->_state[0] += a;
+      this->_state[1] += b;
+      this->_state[2] += c;
+      this->_state[3] += d;
+      this->_state[4] += e;
+      this->_state[5] += f;
+      this->_state[6] += g;
+      this->_state[7] += h;
+    }
+
+    uint64_t _state[8] = {
+        0x6a09e667f3bcc908, 0xbb67ae8584caa73b, 0x3c6ef372fe94f82b, 0xa54ff53a5f1d36f1,
+        0x510e527fade682d1, 0x9b05688c2b3e6c1f, 0x1f83d9abfb41bd6b, 0x5be0cd19137e2179};
+    unsigned char _block[kBlockSize]{};
+    size_t _buffered = 0;
+    uint64_t _length = 0;
+  };
+
+  namespace {
+    auto base64_encode(const unsigned char* data, size_t size) -> std::string {
+      static const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+      std::string out;
+      for (size_t i = 0; i < size; i += 3) {
+        unsigned int chunk = unsigned(data[i]) << 16U;
+        if (i + 1 < size) chunk |= unsigned(data[i + 1]) << 8U;
+        if (i + 2 < size) chunk |= unsigned(data[i + 2]);
+
+        out += alphabet[(chunk >> 18U) & 63U];
+        out += alphabet[(chunk >> 12U) & 63U];
+        out += i + 1 < size ? alphabet[(chunk >> 6U) & 63U] : '=';
+        out += i + 2 < size ? alphabet[chunk & 63U] : '=';
+      }
+      return out;
+    }
+  }  // namespace
+
+  /**
+   * Verifies a body against the sha512 hashes of an SRI string ("sha512-<base64> ...").
+   * Bytes are fed with Update() as they arrive, so verification needs no extra pass.
+   * Strings without a sha512 hash (e.g. sha1 from old lockfiles) are not checked.
+   */
+  class Checker {
+  public:
+    explicit Checker(const std::string& sri) {
+      size_t start = 0;
+      while (start < sri.size()) {
+        size_t end = std::min(sri.find(' ', start), sri.size());
+        auto hash  = sri.substr(start, end - start);
+        if (hash.compare(0, 7, "sha512-") == 0) {
+          this->_expected.emplace_back(hash.substr(7, hash.find('?') - 7));  // drop SRI options
+        }
+        start = end + 1;
+      }
+    }
+
+    [[nodiscard]] auto Enabled() const noexcept -> bool {
+      return !this->_expected.empty();
+    }
+
+    void Update(const void* data, size_t size) {
+      if (this->Enabled()) this->_hash.Update(data, size);
+    }
+
+    /** @throws IntegrityException when the body matches none of the expected hashes */
+    void Verify() {
+      if (!this->Enabled()) return;
+
+      auto digest = this->_hash.Final();
+      auto actual = base64_encode(digest.data(), digest.size());
+      for (const auto& expected : this->_expected) {
+        if (expected == actual) return;
+      }
+      throw IntegrityException{"Integrity check failed, got sha512-" + actual};
+    }
+
+  private:
+    std::vector<std::string> _expected;
+    Sha512 _hash;
+  };
+}  // namespace integrity
+
+#endif  //NPM_INTEGRITY_HPP
@@ -0,0 +1,67 @@
+#include "../../src/format/gzip/checksum.h"
+#include <algorithm>
+#include <cassert>
+#include <string>
+#include <vector>
+
+namespace gzip {
+  auto bytes(const std::string& text) -> std::vector<unsigned char> {
+    return std::vector<unsigned char>(text.begin(), text.end());
+  }
+
+  /** long enough for the vector kernels, with an odd tail for the scalar one */
+  auto sample() -> std::vector<unsigned char> {
+    std::vector<unsigned char> data(100003);
+    for (size_t i = 0; i < data.size(); i++) {
+      data[i] = (unsigned char) (i * 7 + 3 * (i >> 8));
+    }
+    return data;
+  }
+
+  void test_Crc32() {
+    auto check = bytes("123456789");
+    assert(Crc32(0, check.data(), check.size()) == 0xcbf43926);
+    assert(Crc32(0, nullptr, 0) == 0);
+
+    auto data = sample();
+    assert(Crc32(0, data.data(), data.size()) == 0xc4f60c8a);
+
+    std::vector<unsigned char> ones(100003, 0xff);
+    assert(Crc32(0, ones.data(), ones.size()) == 0x4e275cb1);
+  }
+
+  void test_Adler32() {
+    auto check = bytes("Wikipedia");
+    assert(Adler32(1, check.data(), check.size()) == 0x11e60398);
+    assert(Adler32(1, nullptr, 0) == 1);
+
+    auto data = sample();
+    assert(Adler32(1, data.data(), data.size()) == 0x3fc49d5a);
+
+    std::vector<unsigned char> ones(100003, 0xff);
+    assert(Adler32(1, ones.data(), ones.size()) == 0xab183329);
+  }
+
+  void test_Checksum_Chunks() {
+    auto data = sample();
+    for (size_t chunk : {size_t(1), size_t(15), size_t(64), size_t(100), size_t(4099)}) {
+      unsigned int crc   = 0;
+      unsigned int adler = 1;
+      for (size_t i = 0; i < data.size(); i += chunk) {
+        size_t size = std::min(chunk, data.size() - i);
+        crc         = Crc32(crc, data.data() + i, size);
+        adler       = Adler32(adler, data.data() + i, size);
+      }
+      assert(crc == 0xc4f60c8a);
+      assert(adler == 0x3fc49d5a);
+    }
+  }
+}  // namespace gzip
+
+auto main() -> int {
+  gzip::test_Crc32();
+  gzip::test_Adler32();
+  gzip::test_Checksum_Chunks();
+
+  return 0;
+}
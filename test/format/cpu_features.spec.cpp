@@ -0,0 +1,43 @@
+#include "../../src/format/gzip/cpu_features.h"
+#include <cassert>
+
+namespace gzip {
+  void test_GetCpuFeatures_Detected() {
+    const CpuFeatures& features = GetCpuFeatures();
+    assert(&features == &GetCpuFeatures());
+
+#if (defined(__x86_64__) || defined(_M_X64)) && defined(__GNUC__)
+    __builtin_cpu_init();
+    assert(features.ssse3 == !!__builtin_cpu_supports("ssse3"));
+    assert(features.sse41 == !!__builtin_cpu_supports("sse4.1"));
+    assert(features.sse42 == !!__builtin_cpu_supports("sse4.2"));
+    assert(features.avx2 == !!__builtin_cpu_supports("avx2"));
+    assert(!features.neon);
+#elif defined(__aarch64__)
+    assert(features.neon);
+#endif
+
+    // whatever the binary was compiled for is there at runtime too
+#ifdef __SSSE3__
+    assert(features.ssse3);
+#endif
+#ifdef __SSE4_2__
+    assert(features.sse42);
+#endif
+#ifdef __PCLMUL__
+    assert(features.pclmul);
+#endif
+#ifdef __AVX2__
+    assert(features.avx2);
+#endif
+#ifdef __BMI2__
+    assert(features.bmi2);
+#endif
+  }
+}  // namespace gzip
+
+auto main() -> int {
+  gzip::test_GetCpuFeatures_Detected();
+
+  return 0;
+}
@@ -0,0 +1,250 @@
+#include "../../src/format/gzip/decompressor.h"
+#include "../../src/format/gzip/inflater.h"
+#include <cassert>
+#include <string>
+#include <vector>
+
+namespace gzip {
+  /** gzip -9 of pattern(): a dynamic block stream that slides the window several times */
+  const std::vector<unsigned char> kDynamic = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0xed, 0xd5, 0xcb, 0x6d, 0x24, 0x31,
+    0x10, 0x44, 0x41, 0x8b, 0x1a, 0xe0, 0x5f, 0xa2, 0xff, 0x8e, 0x6d, 0x16, 0x65, 0xc4, 0x5e, 0xe2,
+    0x4e, 0x60, 0x8a, 0xaf, 0x6b, 0x18, 0xad, 0xb5, 0xaf, 0xf7, 0xfe, 0x8d, 0x31, 0xbe, 0x39, 0xe7,
+    0xb7, 0xd6, 0xfa, 0xf6, 0x6e, 0xdf, 0x39, 0xfd, 0x6b, 0x3f, 0xe3, 0xeb, 0xbf, 0xf3, 0x1b, 0x77,
+    0x7d, 0xb3, 0xe7, 0xe0, 0xaa, 0x93, 0xbb, 0xe7, 0xe8, 0x69, 0xf3, 0x6b, 0x7d, 0x7d, 0x7d, 0xb4,
+    0x6f, 0xcc, 0xfe, 0xcd, 0x35, 0xbe, 0xb5, 0xe7, 0xb7, 0xcf, 0xfa, 0xce, 0x4f, 0xfb, 0xda, 0x6f,
+    0xff, 0xfa, 0x1d, 0xdf, 0xe8, 0x39, 0x38, 0x7b, 0x4e, 0xae, 0x3a, 0xba, 0x5b, 0xff, 0x4e, 0x1f,
+    0x5f, 0x1b, 0xf3, 0xeb, 0x73, 0x7d, 0x63, 0xb5, 0x6f, 0xee, 0xfe, 0xad, 0x33, 0xbe, 0xfd, 0x33,
+    0xbf, 0xf3, 0xbb, 0xbe, 0x76, 0x6b, 0xa2, 0x1c, 0x1c, 0x3d, 0x27, 0x67, 0xcf, 0xd1, 0xd5, 0x32,
+    0x54, 0xcf, 0x50, 0x23, 0x43, 0xcd, 0x0c, 0xb5, 0x32, 0xd4, 0xce, 0x50, 0x27, 0x33, 0xfd, 0x64,
+    0xa4, 0xdf, 0x4c, 0x74, 0x6b, 0xa2, 0x1c, 0xcc, 0x8c, 0x99, 0xa9, 0xe7, 0xe8, 0x6c, 0x19, 0xaa,
+    0x67, 0xa8, 0x91, 0xa1, 0x66, 0x86, 0x5a, 0x19, 0x6a, 0x67, 0xa8, 0x93, 0x99, 0x7e, 0x32, 0xd2,
+    0x6f, 0x26, 0xba, 0x35, 0x51, 0x0e, 0xb6, 0x9e, 0x93, 0xf9, 0xc5, 0x0c, 0x95, 0x9b, 0x66, 0xe4,
+    0x6f, 0xe5, 0x9e, 0x3b, 0x49, 0x4e, 0x92, 0xb4, 0x24, 0xe9, 0x49, 0x32, 0x92, 0x64, 0x26, 0xc9,
+    0xba, 0x6f, 0xa2, 0x8c, 0x54, 0x49, 0x5a, 0x25, 0xa9, 0x9b, 0x8e, 0x5c, 0x74, 0xe6, 0x9e, 0x2b,
+    0x49, 0x76, 0x92, 0x9c, 0x24, 0x69, 0x49, 0xd2, 0x93, 0x64, 0x24, 0xc9, 0xbc, 0x35, 0x51, 0x0e,
+    0xee, 0x4a, 0x72, 0x2a, 0x49, 0xcb, 0x4d, 0xeb, 0xa2, 0x23, 0xf7, 0x9c, 0x49, 0xb2, 0x92, 0x64,
+    0x27, 0xc9, 0x49, 0x92, 0x96, 0x24, 0x3d, 0x49, 0xc6, 0xad, 0x89, 0x72, 0x70, 0xd5, 0xc9, 0x5d,
+    0x49, 0x4e, 0x6e, 0x9a, 0xeb, 0x7e, 0x75, 0xcf, 0x91, 0x24, 0x33, 0x49, 0x56, 0x92, 0xec, 0x24,
+    0x39, 0x49, 0xd2, 0x92, 0xa4, 0xdf, 0x9a, 0xa8, 0xd5, 0xc7, 0xeb, 0xf5, 0xf1, 0x72, 0x74, 0xe7,
+    0xa6, 0x27, 0x17, 0x6d, 0xb9, 0x67, 0x4f, 0x92, 0x91, 0x24, 0x33, 0x49, 0x56, 0x92, 0xec, 0x24,
+    0x39, 0x49, 0xd2, 0x6e, 0x4d, 0xd4, 0xea, 0xe3, 0xf5, 0xfa, 0x78, 0x39, 0xba, 0x72, 0xd3, 0x8c,
+    0x9c, 0x0f, 0x90, 0xa1, 0x92, 0xa4, 0x27, 0xc9, 0x48, 0x92, 0x99, 0x24, 0x2b, 0x49, 0x76, 0x92,
+    0x9c, 0xfb, 0x26, 0x7a, 0xeb, 0x54, 0x1f, 0xaf, 0x16, 0x2a, 0x37, 0x5d, 0xb9, 0xe8, 0xce, 0x3d,
+    0x4f, 0x92, 0xb4, 0x24, 0xe9, 0x49, 0x32, 0x92, 0x64, 0x26, 0xc9, 0x4a, 0x92, 0x7d, 0x6b, 0xa2,
+    0xb7, 0x4e, 0xb5, 0x4f, 0x6f, 0xa1, 0x72, 0xd3, 0xfc, 0x6c, 0x3e, 0x40, 0x86, 0x4a, 0x92, 0x93,
+    0x24, 0x2d, 0x49, 0x7a, 0x92, 0x8c, 0x24, 0x99, 0x49, 0xb2, 0x6e, 0x4d, 0xf4, 0xd6, 0xa9, 0xf6,
+    0xa9, 0x92, 0xd4, 0x4d, 0x73, 0xdd, 0x7c, 0x80, 0x0c, 0x95, 0x24, 0x3b, 0x49, 0x4e, 0x92, 0xb4,
+    0x24, 0xe9, 0x49, 0x32, 0x92, 0x64, 0xde, 0x9a, 0xe8, 0xad, 0x53, 0xed, 0x53, 0x25, 0x69, 0xb9,
+    0x69, 0x5d, 0x74, 0xe4, 0x9e, 0x33, 0x49, 0x56, 0x92, 0xec, 0x24, 0x39, 0x49, 0xd2, 0x92, 0xa4,
+    0x27, 0xc9, 0xb8, 0x35, 0xd1, 0x5b, 0xa7, 0xda, 0xa7, 0x4a, 0x72, 0x72, 0xd3, 0x8c, 0xfc, 0xd5,
+    0x3d, 0x47, 0x92, 0xcc, 0x24, 0x59, 0x49, 0xb2, 0x93, 0xe4, 0x24, 0x49, 0x4b, 0x92, 0x7e, 0xdf,
+    0x44, 0x6f, 0x9d, 0xea, 0xe3, 0xd5, 0x42, 0xe5, 0xa6, 0x27, 0x17, 0x6d, 0xb9, 0x67, 0x4f, 0x92,
+    0x91, 0x24, 0x33, 0x49, 0x56, 0x92, 0xec, 0x24, 0x39, 0x49, 0xd2, 0x6e, 0x4d, 0xf4, 0xd6, 0xa9,
+    0xf6, 0xa9, 0x92, 0xac, 0xf6, 0xfe, 0x78, 0xf9, 0x00, 0x19, 0x2a, 0x49, 0x7a, 0x92, 0x8c, 0x24,
+    0x99, 0x49, 0xb2, 0x92, 0x64, 0x27, 0xc9, 0xb9, 0x35, 0xd1, 0x5b, 0xa7, 0xda, 0xa7, 0x4a, 0x32,
+    0x5b, 0xfd, 0xf1, 0x32, 0x54, 0xee, 0x79, 0x92, 0xa4, 0x25, 0x49, 0x4f, 0x92, 0x91, 0x24, 0x33,
+    0x49, 0x56, 0x92, 0xec, 0x5b, 0x13, 0xbd, 0x75, 0xaa, 0x7d, 0x7a, 0x0b, 0xd5, 0xea, 0x8f, 0x97,
+    0xa1, 0x72, 0xcf, 0x9d, 0x24, 0x27, 0x49, 0x5a, 0x92, 0xf4, 0x24, 0x19, 0x49, 0x32, 0x93, 0x64,
+    0xdd, 0x9a, 0xe8, 0xad, 0x53, 0xed, 0x53, 0x25, 0xa9, 0x9b, 0x66, 0xe4, 0x7c, 0x80, 0x0c, 0x95,
+    0x24, 0x3b, 0x49, 0x4e, 0x92, 0xb4, 0x24, 0xe9, 0x49, 0x32, 0x92, 0x64, 0xde, 0x37, 0xd1, 0x5b,
+    0xa7, 0xf7, 0x16, 0x64, 0xa8, 0x56, 0x7f, 0xbc, 0x0c, 0x95, 0x7b, 0xce, 0x24, 0x59, 0x49, 0xb2,
+    0x93, 0xe4, 0x24, 0x49, 0x4b, 0x92, 0x9e, 0x24, 0xe3, 0xd6, 0x44, 0x6f, 0x9d, 0x6a, 0x9f, 0x2a,
+    0xc9, 0x69, 0xef, 0x8f, 0xf7, 0xd5, 0x3d, 0x47, 0x92, 0xcc, 0x24, 0x59, 0x49, 0xb2, 0x93, 0xe4,
+    0x24, 0x49, 0x4b, 0x92, 0x7e, 0x6b, 0xa2, 0xb7, 0x4e, 0xb5, 0x4f, 0x75, 0x74, 0xb7, 0xfa, 0xe3,
+    0x65, 0xa8, 0xdc, 0xb3, 0x27, 0xc9, 0x48, 0x92, 0x99, 0x24, 0x2b, 0x49, 0x76, 0x92, 0x9c, 0x24,
+    0x69, 0xb7, 0x26, 0x7a, 0xeb, 0x54, 0xfb, 0x54, 0x49, 0x56, 0xab, 0x3f, 0x5e, 0x86, 0xca, 0x3d,
+    0x5b, 0x92, 0xf4, 0x24, 0x19, 0x49, 0x32, 0x93, 0x64, 0x25, 0xc9, 0x4e, 0x92, 0x73, 0x6b, 0xa2,
+    0xb7, 0x4e, 0xb5, 0x4f, 0x95, 0x64, 0xfe, 0xbd, 0x9a, 0xf9, 0x00, 0x19, 0x2a, 0x49, 0x5a, 0x92,
+    0xf4, 0x24, 0x19, 0x49, 0x32, 0x93, 0x64, 0x25, 0xc9, 0xbe, 0x6f, 0xa2, 0xb7, 0x4e, 0xef, 0x2d,
+    0xc8, 0x50, 0xef, 0xd5, 0xcc, 0x50, 0xf5, 0x66, 0x26, 0xc9, 0x49, 0x92, 0x96, 0x24, 0x3d, 0x49,
+    0x46, 0x92, 0xcc, 0x24, 0x59, 0xb7, 0x26, 0x7a, 0xeb, 0x54, 0xfb, 0x54, 0x49, 0xfe, 0x5e, 0xcd,
+    0x0c, 0x55, 0x6f, 0x66, 0x92, 0xec, 0x24, 0x39, 0x49, 0xd2, 0x92, 0xa4, 0x27, 0xc9, 0x48, 0x92,
+    0x79, 0x6b, 0xa2, 0xb7, 0x4e, 0xb5, 0x4f, 0x95, 0xa4, 0xbd, 0x57, 0x33, 0x43, 0xd5, 0x9b, 0x99,
+    0x24, 0x2b, 0x49, 0x76, 0x92, 0x9c, 0x24, 0x69, 0x49, 0xd2, 0x93, 0x64, 0xdc, 0x9a, 0xe8, 0xad,
+    0x53, 0xed, 0x53, 0x25, 0x39, 0xef, 0xd5, 0xcc, 0x50, 0xf5, 0x66, 0x26, 0xc9, 0x4c, 0x92, 0x95,
+    0x24, 0x3b, 0x49, 0x4e, 0x92, 0xb4, 0x24, 0xe9, 0xb7, 0x26, 0x7a, 0xeb, 0x54, 0xfb, 0x54, 0x47,
+    0xf7, 0xdf, 0xab, 0x99, 0x0f, 0x90, 0xa1, 0x92, 0x64, 0x24, 0xc9, 0x4c, 0x92, 0x95, 0x24, 0x3b,
+    0x49, 0x4e, 0x92, 0xb4, 0xfb, 0x26, 0x7a, 0xeb, 0xf4, 0xde, 0x82, 0x0c, 0xf5, 0x5e, 0xcd, 0x0c,
+    0x55, 0x6f, 0x66, 0x92, 0xf4, 0x24, 0x19, 0x49, 0x32, 0x93, 0x64, 0x25, 0xc9, 0x4e, 0x92, 0x73,
+    0x6b, 0xa2, 0xb7, 0x4e, 0xb5, 0x4f, 0x95, 0x64, 0xbe, 0x57, 0x33, 0x43, 0xd5, 0x9b, 0x99, 0x24,
+    0x2d, 0x49, 0x7a, 0x92, 0x8c, 0x24, 0x99, 0x49, 0xb2, 0x92, 0x64, 0xdf, 0x9a, 0xe8, 0xad, 0x53,
+    0xed, 0xd3, 0x5b, 0xa8, 0xf7, 0x6a, 0x66, 0xa8, 0x7a, 0x33, 0x93, 0xe4, 0x24, 0x49, 0x4b, 0x92,
+    0x9e, 0x24, 0x23, 0x49, 0x66, 0x92, 0xac, 0x5b, 0x13, 0xbd, 0x75, 0xaa, 0x7d, 0xaa, 0x24, 0x7f,
+    0xaf, 0x66, 0x86, 0xaa, 0x37, 0x33, 0x49, 0x76, 0x92, 0x9c, 0x24, 0x69, 0x49, 0xd2, 0x93, 0x64,
+    0x24, 0xc9, 0xbc, 0x35, 0xd1, 0x5b, 0xa7, 0xda, 0xa7, 0x4a, 0xd2, 0x20, 0x0c, 0x61, 0x08, 0x43,
+    0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30,
+    0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08,
+    0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86,
+    0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61,
+    0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10,
+    0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c,
+    0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2,
+    0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21,
+    0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18,
+    0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84,
+    0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43,
+    0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30,
+    0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08,
+    0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86,
+    0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61,
+    0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10,
+    0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c,
+    0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2,
+    0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21,
+    0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18,
+    0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84,
+    0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43,
+    0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30,
+    0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08,
+    0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86,
+    0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61,
+    0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10,
+    0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c,
+    0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2,
+    0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21,
+    0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18,
+    0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84,
+    0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43,
+    0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30,
+    0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08,
+    0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86,
+    0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61,
+    0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10,
+    0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c,
+    0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2,
+    0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21,
+    0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18,
+    0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84,
+    0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43,
+    0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30,
+    0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08,
+    0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86,
+    0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61,
+    0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10,
+    0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c,
+    0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2,
+    0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21,
+    0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18,
+    0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84,
+    0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43,
+    0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30,
+    0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08,
+    0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86,
+    0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61,
+    0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10,
+    0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c,
+    0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2,
+    0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21,
+    0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18,
+    0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84,
+    0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43,
+    0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30,
+    0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08,
+    0x43, 0x18, 0xc2, 0x10, 0x86, 0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0x18, 0xc2, 0x10, 0x86,
+    0x30, 0x84, 0x21, 0x0c, 0x61, 0x08, 0x43, 0xf8, 0x7f, 0x20, 0xfc, 0x0f, 0x38, 0xe4, 0xed, 0x85,
+    0x52, 0x3a, 0x03, 0x00,
+  };
+
+  /** zlib stream of one fixed huffman block */
+  const std::vector<unsigned char> kFixed = {
+    0x78, 0x01, 0x2b, 0xc9, 0x48, 0x55, 0x28, 0x2c, 0xcd, 0x4c, 0xce, 0x56, 0x48, 0x2a, 0xca, 0x2f,
+    0xcf, 0x53, 0x48, 0xcb, 0xaf, 0x50, 0xc8, 0x2a, 0xcd, 0x2d, 0x28, 0x56, 0xc8, 0x2f, 0x4b, 0x2d,
+    0x52, 0x28, 0x01, 0x4a, 0xe7, 0x24, 0x56, 0x55, 0x2a, 0xa4, 0xe4, 0xa7, 0xeb, 0x80, 0x79, 0x68,
+    0x8a, 0x01, 0xfe, 0x64, 0x17, 0x79,
+  };
+
+  /** raw deflate stream of one stored block */
+  const std::vector<unsigned char> kStored = {
+    0x01, 0x0c, 0x00, 0xf3, 0xff, 0x73, 0x74, 0x6f, 0x72, 0x65, 0x64, 0x20, 0x62, 0x79, 0x74, 0x65,
+    0x73,
+  };
+
+  auto pattern() -> std::string {
+    std::string text;
+    for (int i = 0; i < 50000; i++) {
+      text += std::to_string(i % 7) + std::to_string(i % 13) + std::to_string(i % 5) + "-";
+    }
+    return text;
+  }
+
+  auto inflate(const std::vector<unsigned char>& data, size_t chunk, int* result = nullptr) -> std::string {
+    std::string out;
+    Inflater inflater([&out](const unsigned char* output, size_t size) {
+      out.append(reinterpret_cast<const char*>(output), size);
+    });
+
+    int status = 0;
+    for (size_t i = 0; i < data.size() && status == 0; i += chunk) {
+      status = inflater.Feed(data.data() + i, std::min(chunk, data.size() - i));
+    }
+    if (status == 0) status = inflater.Finish();
+    if (result) *result = status;
+    return out;
+  }
+
+  void test_Inflater_Chunks() {
+    auto expected = pattern();
+    for (size_t chunk : {size_t(1), size_t(7), size_t(100), size_t(4096), kDynamic.size()}) {
+      int result;
+      auto out = inflate(kDynamic, chunk, &result);
+      assert(result == 0);
+      assert(out == expected);
+    }
+  }
+
+  void test_Inflater_Formats() {
+    for (size_t chunk : {size_t(1), size_t(3), size_t(64)}) {
+      assert(inflate(kFixed, chunk) == "the quick brown fox jumps over the lazy dog, the quick brown fox");
+      assert(inflate(kStored, chunk) == "stored bytes");
+    }
+  }
+
+  void test_Inflater_Errors() {
+    int result;
+    inflate(std::vector<unsigned char>(kDynamic.begin(), kDynamic.end() - 3), 512, &result);
+    assert(result == -1);
+
+    auto size = kDynamic;
+    size[size.size() - 1] ^= 1U;
+    inflate(size, 512, &result);
+    assert(result == -1);
+
+    auto crc = kDynamic;
+    crc[crc.size() - 8] ^= 1U;
+    inflate(crc, 512, &result);
+    assert(result == -1);
+
+    std::vector<unsigned char> adler(kFixed.begin(), kFixed.end());
+    adler.back() ^= 1U;
+    inflate(adler, 7, &result);
+    assert(result == -1);
+  }
+
+  void test_Decompressor_Feed() {
+    auto expected = pattern();
+    std::vector<unsigned char> out(expected.size());
+    unsigned int size = Decompressor::Feed(kDynamic.data(), kDynamic.size(), out.data(), out.size(), true);
+    assert(size == expected.size());
+    assert(std::string(out.begin(), out.end()) == expected);
+
+    auto crc = kDynamic;
+    crc[crc.size() - 8] ^= 1U;
+    assert(Decompressor::Feed(crc.data(), crc.size(), out.data(), out.size(), true) == (unsigned int) -1);
+    assert(Decompressor::Feed(crc.data(), crc.size(), out.data(), out.size(), false) == expected.size());
+
+    std::vector<unsigned char> adler(kFixed.begin(), kFixed.end());
+    adler.back() ^= 1U;
+    assert(Decompressor::Feed(kFixed.data(), kFixed.size(), out.data(), out.size(), true) == 64);
+    assert(Decompressor::Feed(adler.data(), adler.size(), out.data(), out.size(), true) == (unsigned int) -1);
+  }
+}  // namespace gzip
+
+auto main() -> int {
+  gzip::test_Inflater_Chunks();
+  gzip::test_Inflater_Formats();
+  gzip::test_Inflater_Errors();
+  gzip::test_Decompressor_Feed();
+
+  return 0;
+}
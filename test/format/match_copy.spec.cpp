@@ -0,0 +1,42 @@
+#include "../../src/format/gzip/match_copy.h"
+#include <cassert>
+#include <vector>
+
+namespace gzip {
+  void test_CopyMatch_Overlap() {
+    for (unsigned int offset = 1; offset <= 70; offset++) {
+      for (unsigned int length = 3; length <= 258; length++) {
+        std::vector<unsigned char> out(offset + length + kMatchCopyOverrun + 1, 0xee);
+        for (unsigned int i = 0; i < offset; i++) {
+          out[i] = (unsigned char) (i * 37 + 1);
+        }
+
+        CopyMatch(out.data() + offset, offset, length);
+
+        for (unsigned int i = offset; i < offset + length; i++) {
+          assert(out[i] == out[i - offset]);
+        }
+        assert(out.back() == 0xee);
+      }
+    }
+  }
+
+  void test_CopyMatch_Far() {
+    std::vector<unsigned char> out(40000 + 258 + kMatchCopyOverrun);
+    for (size_t i = 0; i < 40000; i++) {
+      out[i] = (unsigned char) (i ^ (i >> 7));
+    }
+
+    CopyMatch(out.data() + 40000, 32768, 258);
+    for (size_t i = 0; i < 258; i++) {
+      assert(out[40000 + i] == out[40000 - 32768 + i]);
+    }
+  }
+}  // namespace gzip
+
+auto main() -> int {
+  gzip::test_CopyMatch_Overlap();
+  gzip::test_CopyMatch_Far();
+
+  return 0;
+}
@@ -67,8 +67,18 @@ namespace packagelock {
     }
   }
 
+  void test_V1Parser_Integrity() {
+    std::string lock = R"({"dependencies": {"a": {"resolved": "http://r/a.tgz", "integrity": "sha512-q+/9=="}, "b": {}}})";
+
+    auto dep = V1Parser::parse(lock);
+    assert(dep.size() == 2);
+    assert(dep[0].integrity == "sha512-q+/9==");
+    assert(dep[1].integrity.empty());
+  }
+
   void test_V1Parser() {
     test_V1Parser_Counts();
+    test_V1Parser_Integrity();
     test_V1Parser_Substring();
     test_V1Parser_FindPairClose();
     test_V1Parser_ParseValue();
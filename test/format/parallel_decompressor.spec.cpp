@@ -0,0 +1,197 @@
+#include "../../src/format/gzip/checksum.h"
+#include "../../src/format/gzip/decompressor.h"
+#include <cassert>
+#include <string>
+#include <vector>
+
+namespace gzip {
+  /** LSB-first bit writer for building deflate streams */
+  class BitWriter {
+  public:
+    void Put(unsigned int value, int bits) {
+      for (int i = 0; i < bits; i++, this->count++) {
+        if (this->count % 8 == 0) this->bytes.push_back(0);
+        this->bytes.back() |= ((value >> i) & 1) << (this->count % 8);
+      }
+    }
+
+    /** huffman codes go out most significant bit first */
+    void PutCode(unsigned int code, int length) {
+      for (int i = length - 1; i >= 0; i--) this->Put(code >> i, 1);
+    }
+
+    std::vector<unsigned char> bytes;
+    size_t count = 0;
+  };
+
+  auto canonical(const std::vector<int>& lengths) -> std::vector<unsigned int> {
+    std::vector<unsigned int> codes(lengths.size());
+    unsigned int code = 0;
+    for (int length = 1; length <= 15; length++) {
+      for (size_t symbol = 0; symbol < lengths.size(); symbol++) {
+        if (lengths[symbol] == length) codes[symbol] = code++;
+      }
+      code <<= 1;
+    }
+    return codes;
+  }
+
+  /**
+   * Dynamic block with a fixed shape: literals 0..246 take 8 bits, 247..255,
+   * end of block and match lengths 3..10 take 9; offset codes 0 and 1 take 4
+   * bits, the other 28 take 5. Matches are found greedily at a few offsets,
+   * some reaching far back into earlier blocks.
+   */
+  void writeDynamic(BitWriter& writer, const std::vector<unsigned char>& data, size_t from, size_t to, bool last) {
+    std::vector<int> lengths(265, 8);
+    for (size_t symbol = 247; symbol < lengths.size(); symbol++) lengths[symbol] = 9;
+    auto codes = canonical(lengths);
+    std::vector<int> offset_lengths(30, 5);
+    offset_lengths[0] = offset_lengths[1] = 4;
+    auto offset_codes = canonical(offset_lengths);
+
+    writer.Put(last, 1);
+    writer.Put(2, 2);
+    writer.Put(265 - 257, 5);
+    writer.Put(30 - 1, 5);
+    writer.Put(12 - 4, 4);
+    // code length code in order 16 17 18 0 8 7 9 6 10 5 11 4: 8 -> "0", 5 -> "10", 4 -> "110", 9 -> "111"
+    for (unsigned int length : {0, 0, 0, 0, 1, 0, 3, 0, 0, 2, 0, 3}) writer.Put(length, 3);
+    for (int length : lengths) writer.PutCode(length == 8 ? 0 : 7, length == 8 ? 1 : 3);
+    for (int length : offset_lengths) writer.PutCode(length == 4 ? 6 : 2, length == 4 ? 3 : 2);
+
+    for (size_t i = from; i < to;) {
+      size_t best = 0, best_offset = 0;
+      for (size_t offset : {1, 2, 3, 7, 100, 1000, 20000, 32768}) {
+        if (offset > i) continue;
+        size_t length = 0;
+        while (length < 10 && i + length < to && data[i + length] == data[i + length - offset]) length++;
+        if (length > best) best = length, best_offset = offset;
+      }
+
+      if (best < 3) {
+        writer.PutCode(codes[data[i]], lengths[data[i]]);
+        i++;
+        continue;
+      }
+
+      writer.PutCode(codes[254 + best], lengths[254 + best]);
+      unsigned int code = 0;
+      while (code + 1 < 30 && (kOffsetCode[code + 1] & 0x7fff) <= best_offset) code++;
+      writer.PutCode(offset_codes[code], offset_lengths[code]);
+      writer.Put((unsigned int) best_offset - (kOffsetCode[code] & 0x7fff), (kOffsetCode[code] >> 16) & 15);
+      i += best;
+    }
+    writer.PutCode(codes[256], lengths[256]);
+  }
+
+  void writeStored(BitWriter& writer, const std::vector<unsigned char>& data, size_t from, size_t to, bool last) {
+    writer.Put(last, 1);
+    writer.Put(0, 2);
+    writer.count = writer.bytes.size() * 8;
+    unsigned int length = (unsigned int) (to - from);
+    writer.Put(length, 16);
+    writer.Put(~length, 16);
+    writer.bytes.insert(writer.bytes.end(), data.begin() + from, data.begin() + to);
+    writer.count = writer.bytes.size() * 8;
+  }
+
+  /** gzip member of blocks covering block_size bytes each, every fifth one stored */
+  auto compress(const std::vector<unsigned char>& data, size_t block_size) -> std::vector<unsigned char> {
+    BitWriter writer;
+    writer.bytes = {0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03};
+    writer.count = writer.bytes.size() * 8;
+
+    for (size_t from = 0, block = 0; from < data.size(); from += block_size, block++) {
+      size_t to = std::min(data.size(), from + block_size);
+      if (block % 5 == 4) {
+        writeStored(writer, data, from, to, to == data.size());
+      } else {
+        writeDynamic(writer, data, from, to, to == data.size());
+      }
+    }
+
+    unsigned int crc = Crc32(0, data.data(), data.size());
+    writer.count     = writer.bytes.size() * 8;
+    writer.Put(crc, 32);
+    writer.Put((unsigned int) data.size(), 32);
+    return writer.bytes;
+  }
+
+  /** words drawn from a small vocabulary, with runs and long-range repeats */
+  auto sample(size_t size) -> std::vector<unsigned char> {
+    const std::vector<std::string> words = {"module", "exports", "require", "function", "return", "const ", "=> ", "{\n", "}\n", "aaaa", "    "};
+    std::vector<unsigned char> data;
+    unsigned int seed = 12345;
+    while (data.size() < size) {
+      seed = seed * 1103515245 + 12345;
+      if ((seed >> 16) % 7 == 0) {
+        data.push_back((unsigned char) (seed >> 8));
+        continue;
+      }
+      const auto& word = words[(seed >> 16) % words.size()];
+      data.insert(data.end(), word.begin(), word.end());
+    }
+    data.resize(size);
+    return data;
+  }
+
+  void test_FeedParallel_Chunks() {
+    auto data       = sample(1 << 20);
+    auto compressed = compress(data, 50000);
+    assert(compressed.size() > 4 * 32768);
+
+    std::vector<unsigned char> serial(data.size());
+    assert(Decompressor::Feed(compressed.data(), compressed.size(), serial.data(), serial.size(), true) == data.size());
+    assert(serial == data);
+
+    for (unsigned int threads : {2, 3, 4, 8}) {
+      std::vector<unsigned char> out(data.size());
+      assert(Decompressor::FeedParallel(compressed.data(), compressed.size(), out.data(), out.size(), true, threads, 32768) == data.size());
+      assert(out == data);
+    }
+  }
+
+  void test_FeedParallel_Serial() {
+    auto data       = sample(100000);
+    auto compressed = compress(data, 30000);
+
+    // one thread, or too little input per thread
+    std::vector<unsigned char> out(data.size());
+    assert(Decompressor::FeedParallel(compressed.data(), compressed.size(), out.data(), out.size(), true, 1, 1024) == data.size());
+    assert(out == data);
+    std::fill(out.begin(), out.end(), 0);
+    assert(Decompressor::FeedParallel(compressed.data(), compressed.size(), out.data(), out.size(), true, 4) == data.size());
+    assert(out == data);
+  }
+
+  void test_FeedParallel_Errors() {
+    auto data       = sample(1 << 19);
+    auto compressed = compress(data, 40000);
+    std::vector<unsigned char> out(data.size());
+
+    // output buffer too small
+    assert(Decompressor::FeedParallel(compressed.data(), compressed.size(), out.data(), out.size() - 1, true, 4, 16384) == -1);
+
+    // corrupt trailer
+    auto corrupt = compressed;
+    corrupt[corrupt.size() - 8] ^= 1;
+    assert(Decompressor::FeedParallel(corrupt.data(), corrupt.size(), out.data(), out.size(), true, 4, 16384) == -1);
+
+    // corrupt data in a later chunk
+    corrupt = compressed;
+    corrupt[corrupt.size() * 3 / 4] ^= 0x10;
+    assert(Decompressor::FeedParallel(corrupt.data(), corrupt.size(), out.data(), out.size(), true, 4, 16384) == -1);
+
+    // truncated
+    assert(Decompressor::FeedParallel(compressed.data(), compressed.size() / 2, out.data(), out.size(), true, 4, 16384) == -1);
+  }
+}  // namespace gzip
+
+auto main() -> int {
+  gzip::test_FeedParallel_Chunks();
+  gzip::test_FeedParallel_Serial();
+  gzip::test_FeedParallel_Errors();
+
+  return 0;
+}
@@ -1,35 +1,256 @@
 #include "../../src/format/tar.hpp"
 #include <cassert>
+#include <cstdio>
 #include <tuple>
 
 namespace tar {
-  void test_decodeOctal() {
+  void test_decodeNumber() {
     auto map = {
-        std::make_tuple(std::vector<char>{'0', '0', '0', '0', '0', '0', '0', '2', '1', '2', '2', 0}, 1106)};
+        std::make_tuple(std::vector<char>{'0', '0', '0', '0', '0', '0', '0', '2', '1', '2', '2', 0}, (uint64_t) 1106),
+        std::make_tuple(std::vector<char>{'7', '7', '7', '7', '7', '7', '7', '7', '7', '7', '7', 0}, (uint64_t) 077777777777),
+        std::make_tuple(std::vector<char>{'0', '0', '0', '6', '4', '4', ' ', 0}, (uint64_t) 0644),
+        std::make_tuple(std::vector<char>{' ', ' ', '1', '7', 0, 0, 0, 0}, (uint64_t) 017),
+        std::make_tuple(std::vector<char>{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, (uint64_t) 0),
+        // base-256: 10 GB
+        std::make_tuple(std::vector<char>{(char) 0x80, 0, 0, 0, 0, 0, 0, 0x02, (char) 0x80, 0, 0, 0}, (uint64_t) 10 << 30)};
     for (const auto& i : map) {
       auto [vec, result] = i;  // NOLINT(performance-unnecessary-copy-initialization)
 
-      int dep = decodeOctal(vec.data(), vec.size());
+      uint64_t dep = 1;
+      assert(decodeNumber(vec.data(), vec.size(), dep));
       assert(dep == result);
     }
+
+    for (const auto& vec : {std::vector<char>{'0', '0', '0', '0', '0', '0', '0', '8', '1', '2', '2', 0},
+                            std::vector<char>{'0', '1', 'x', 0},
+                            std::vector<char>{'1', ' ', '2', 0},
+                            std::vector<char>{(char) 0xff, (char) 0xff, (char) 0xff, (char) 0xff}}) {
+      uint64_t dep = 1;
+      assert(!decodeNumber(vec.data(), vec.size(), dep));
+      assert(dep == 1);
+    }
   }
 
-  void test_decodeString() {
+  void test_decodeName() {
     auto map = {
         std::make_tuple(std::vector<char>{'h', 'e', 'l', 'l', 'o', 0, 0, 0, 0, 0}, "hello"),
-        std::make_tuple(std::vector<char>{'h', 'e', 'l', 'l', 'o', ' ', 'w', 'o', 'r', 'l', 'd', 0}, "hello world")};
+        std::make_tuple(std::vector<char>{'h', 'e', 'l', 'l', 'o', ' ', 'w', 'o', 'r', 'l', 'd', 0}, "hello world"),
+        std::make_tuple(std::vector<char>{'f', 'u', 'l', 'l'}, "full")};
     for (const auto& i : map) {
       auto [vec, result] = i;  // NOLINT(performance-unnecessary-copy-initialization)
 
-      std::string dep = decodeString(vec.data(), vec.size());
+      std::string_view dep = decodeName(vec.data(), vec.size());
       assert(dep == result);
     }
   }
+
+  void addFile(std::vector<unsigned char>& archive, const std::string& name, const std::string& body, unsigned int mode = 0644, char typeFlag = '0', const std::string& directory = "") {
+    std::vector<unsigned char> header(HEADER_SIZE, 0);
+    std::memcpy(header.data(), name.data(), std::min(name.size(), (size_t) 100));
+    std::snprintf(reinterpret_cast<char*>(header.data()) + 100, 8, "%07o", mode);
+    std::snprintf(reinterpret_cast<char*>(header.data()) + 124, 12, "%011o", (unsigned int) body.size());
+    header[156] = typeFlag;
+    std::memcpy(header.data() + 257, "ustar\0" "00", 8);
+    std::memcpy(header.data() + 345, directory.data(), directory.size());
+    std::memset(header.data() + 148, ' ', 8);
+    unsigned int checksum = 0;
+    for (unsigned char byte : header) checksum += byte;
+    std::snprintf(reinterpret_cast<char*>(header.data()) + 148, 8, "%06o", checksum);
+    archive.insert(archive.end(), header.begin(), header.end());
+    archive.insert(archive.end(), body.begin(), body.end());
+    archive.resize((archive.size() + PADDING_SIZE - 1) / PADDING_SIZE * PADDING_SIZE, 0);
+  }
+
+  void test_read() {
+    std::string binary("\x7f" "ELF\0\0\x01", 7);
+    std::vector<unsigned char> archive;
+    addFile(archive, "package/", "");
+    addFile(archive, "package/index.js", "module.exports = 1;\n");
+    addFile(archive, "package/addon.node", binary, 0755);
+    size_t complete = archive.size();
+    addFile(archive, "package/cut.js", std::string(1000, 'x'));
+
+    // the last entry runs past the end of what was inflated
+    auto content = read(archive.data(), complete + 700, "package/");
+    assert(content.size() == 2);
+    assert(content[0].name == "index.js");
+    assert(content[0].body == "module.exports = 1;\n");
+    assert(content[1].name == "addon.node");
+    assert(content[1].body == binary);
+    assert(content[0].mode == 0644 && content[1].mode == 0755);
+    assert(content[1].body.data() == reinterpret_cast<const char*>(archive.data()) + 3 * HEADER_SIZE + PADDING_SIZE);
+
+    archive.resize(archive.size() + 2 * HEADER_SIZE, 0);
+    content = read(archive.data(), archive.size(), "package/");
+    assert(content.size() == 3);
+    assert(content[2].name == "cut.js");
+    assert(content[2].body.size() == 1000);
+
+    // a header failing its checksum ends the archive
+    archive[complete + 20] ^= 1;
+    assert(read(archive.data(), archive.size(), "package/").size() == 2);
+    // unless it was summed as signed bytes by an old archiver
+    archive[complete + 20] ^= 1;
+    archive[complete + 90] = 0xe9;
+    std::memset(archive.data() + complete + 148, ' ', 8);
+    int checksum = 0;
+    for (size_t i = complete; i < complete + HEADER_SIZE; i++) checksum += (signed char) archive[i];
+    std::snprintf(reinterpret_cast<char*>(archive.data()) + complete + 148, 8, "%06o", checksum);
+    assert(read(archive.data(), archive.size(), "package/").size() == 3);
+  }
+
+  auto paxRecord(const std::string& key, const std::string& value) -> std::string {
+    std::string record = " " + key + "=" + value + "\n";
+    size_t length      = record.size() + 1;
+    while (std::to_string(length).size() + record.size() != length) length++;
+    return std::to_string(length) + record;
+  }
+
+  /** paths and bodies both read() and a Reader fed byte by byte find in archive */
+  auto readBoth(const std::vector<unsigned char>& archive) -> std::vector<std::pair<std::string, std::string>> {
+    std::vector<std::pair<std::string, std::string>> fromRead, fromReader;
+    for (const auto& entry : read(archive.data(), archive.size(), "package/")) {
+      fromRead.emplace_back(entry.path(), std::string(entry.body));
+    }
+
+    Reader reader("package/", Reader::Handler{
+                                  .onEntry    = [&](std::string_view name, uint64_t, unsigned int) { fromReader.emplace_back(std::string(name), ""); },
+                                  .onData     = [&](const char* data, size_t size) { fromReader.back().second.append(data, size); },
+                                  .onEntryEnd = []() {}});
+    for (unsigned char byte : archive) reader.Feed(&byte, 1);
+    assert(reader.Done());
+    assert(fromRead == fromReader);
+    return fromRead;
+  }
+
+  void test_read_LongNames() {
+    std::string deep = "package/" + std::string(120, 'd') + "/index.js";
+    std::string big(3000, 'b');
+    std::vector<unsigned char> archive;
+    addFile(archive, "package", "", 0755, '5');
+    addFile(archive, "package/lib/", "", 0755, '5');
+    addFile(archive, "pax_global_header", paxRecord("comment", "abc"), 0644, 'g');
+    // ustar prefix holding the directory
+    addFile(archive, "index.js", "1", 0644, '0', "package/" + std::string(130, 'p'));
+    addFile(archive, "x.js", "2", 0644, '0', "package");
+    // GNU long name
+    addFile(archive, "././@LongLink", deep + std::string(1, '\0'), 0644, 'L');
+    addFile(archive, deep.substr(0, 100), "3");
+    // PAX path and size, the header size field left at zero
+    addFile(archive, "PaxHeader/x", paxRecord("mtime", "1.5") + paxRecord("path", "package/" + std::string(200, 'x')) + paxRecord("size", "3000"), 0644, 'x');
+    size_t sized = archive.size();
+    addFile(archive, "package/truncated", big);
+    std::memcpy(archive.data() + sized + 124, "00000000000", 11);
+    std::memset(archive.data() + sized + 148, ' ', 8);
+    unsigned int checksum = 0;
+    for (size_t i = sized; i < sized + HEADER_SIZE; i++) checksum += archive[i];
+    std::snprintf(reinterpret_cast<char*>(archive.data()) + sized + 148, 8, "%06o", checksum);
+    // links and devices are not extracted, and overrides end with the entry they apply to
+    addFile(archive, "package/link", "", 0777, '2');
+    addFile(archive, "package/after.js", "4");
+    archive.resize(archive.size() + 2 * HEADER_SIZE, 0);
+
+    auto content = readBoth(archive);
+    assert(content.size() == 5);
+    assert(content[0] == std::make_pair(std::string(130, 'p') + "/index.js", std::string("1")));
+    assert(content[1] == std::make_pair(std::string("x.js"), std::string("2")));
+    assert(content[2] == std::make_pair(deep.substr(8), std::string("3")));
+    assert(content[3] == std::make_pair(std::string(200, 'x'), big));
+    assert(content[4] == std::make_pair(std::string("after.js"), std::string("4")));
+  }
+
+  void test_read_Unsafe() {
+    std::vector<unsigned char> archive;
+    addFile(archive, "package/../../../outside.js", "1");
+    addFile(archive, "././@LongLink", std::string("package/lib/../../../x.js") + '\0', 0644, 'L');
+    addFile(archive, "package/lib/x.js", "2");
+    addFile(archive, "PaxHeader/x", paxRecord("path", "package/a/.."), 0644, 'x');
+    addFile(archive, "package/a/b", "3");
+    addFile(archive, "package//etc/passwd", "4");
+    addFile(archive, "x.js", "5", 0644, '0', "../up");
+    addFile(archive, "x.js", "6", 0644, '0', "/abs");
+    // dots that are part of a name are fine
+    addFile(archive, "package/..a/b..", "7");
+    addFile(archive, "package/.../x.js", "8");
+    archive.resize(archive.size() + 2 * HEADER_SIZE, 0);
+
+    auto content = readBoth(archive);
+    assert(content.size() == 2);
+    assert(content[0] == std::make_pair(std::string("..a/b.."), std::string("7")));
+    assert(content[1] == std::make_pair(std::string(".../x.js"), std::string("8")));
+  }
+
+  void test_Reader_Corrupt() {
+    std::vector<unsigned char> archive;
+    addFile(archive, "package/a.js", "a");
+    addFile(archive, "package/b.js", "b");
+    archive.resize(archive.size() + 2 * HEADER_SIZE, 0);
+    archive[2 * HEADER_SIZE + 124] = '9';
+
+    size_t entries = 0;
+    Reader reader("package/", Reader::Handler{
+                                  .onEntry    = [&](std::string_view, uint64_t, unsigned int) { entries++; },
+                                  .onData     = [](const char*, size_t) {},
+                                  .onEntryEnd = []() {}});
+    reader.Feed(archive.data(), archive.size());
+    assert(entries == 1);
+    assert(reader.Failed() && !reader.Done());
+  }
+
+  void test_Reader_Chunks() {
+    std::string binary("\x7f" "ELF\0\0\x01", 7);
+    std::string large(1500, 'x');
+    std::vector<unsigned char> archive;
+    addFile(archive, "package/", "");
+    addFile(archive, "package/index.js", "module.exports = 1;\n");
+    addFile(archive, "package/empty", "");
+    addFile(archive, "package/addon.node", binary);
+    addFile(archive, "package/lib/large.js", large);
+    archive.resize(archive.size() + 2 * HEADER_SIZE, 0);
+    archive.resize(archive.size() + 100, 0xee);  // trailing garbage after the end of archive
+
+    for (size_t chunk : {1, 7, 100, 511, 512, 513, 1000, 100000}) {
+      std::vector<std::pair<std::string, std::string>> entries;
+      bool open = false;
+      Reader reader("package/", Reader::Handler{
+                                    .onEntry    = [&](std::string_view name, uint64_t size, unsigned int) {
+                                      assert(!open);
+                                      open = true;
+                                      entries.emplace_back(std::string(name), "");
+                                      entries.back().second.reserve(size);
+                                    },
+                                    .onData     = [&](const char* data, size_t size) {
+                                      assert(open);
+                                      entries.back().second.append(data, size);
+                                    },
+                                    .onEntryEnd = [&]() {
+                                      assert(open);
+                                      open = false;
+                                    }});
+
+      for (size_t at = 0; at < archive.size(); at += chunk) {
+        reader.Feed(archive.data() + at, std::min(chunk, archive.size() - at));
+      }
+      assert(reader.Done() && !reader.Failed());
+
+      assert(!open);
+      assert(entries.size() == 4);
+      assert(entries[0] == std::make_pair(std::string("index.js"), std::string("module.exports = 1;\n")));
+      assert(entries[1] == std::make_pair(std::string("empty"), std::string()));
+      assert(entries[2] == std::make_pair(std::string("addon.node"), binary));
+      assert(entries[3] == std::make_pair(std::string("lib/large.js"), large));
+    }
+  }
 }  // namespace tar
 
 auto main() -> int {
-  tar::test_decodeOctal();
-  tar::test_decodeString();
+  tar::test_decodeNumber();
+  tar::test_decodeName();
+  tar::test_read();
+  tar::test_Reader_Chunks();
+  tar::test_Reader_Corrupt();
+  tar::test_read_LongNames();
+  tar::test_read_Unsafe();
 
   return 0;
 }
@@ -0,0 +1,496 @@
+#include "../../src/proto/event_loop.hpp"
+#include "../../src/proto/http.hpp"
+#include <atomic>
+#include <cassert>
+#include <future>
+#include <thread>
+#include <tuple>
+
+namespace http {
+  void test_parse_headers() {
+    auto headers = parse_headers("HTTP/1.1 200 OK\r\nContent-Length: 12\r\nConnection:close\r\n\r\n");
+
+    assert(headers.size() == 2);
+    assert(headers.at("content-length") == "12");
+    assert(headers.at("connection") == "close");
+  }
+
+  void test_Parser_Framing() {
+    auto map = {
+        std::make_tuple(std::string("HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nhello"), "hello", true),
+        std::make_tuple(std::string("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n5;ext=1\r\nhello\r\n6\r\n world\r\n0\r\n\r\n"), "hello world", true),
+        std::make_tuple(std::string("HTTP/1.1 100 Continue\r\n\r\nHTTP/1.1 200 OK\r\nContent-Length: 2\r\nConnection: close\r\n\r\nok"), "ok", false),
+        std::make_tuple(std::string("HTTP/1.1 204 No Content\r\n\r\n"), "", true)};
+
+    for (const auto& i : map) {
+      auto [raw, body, keepAlive] = i;  // NOLINT(performance-unnecessary-copy-initialization)
+
+      // every split point must produce the same response
+      for (size_t split = 0; split <= raw.size(); split++) {
+        Parser parser;
+        size_t consumed = parser.Feed(raw.data(), split);
+        consumed += parser.Feed(raw.data() + split, raw.size() - split);
+
+        assert(consumed == raw.size());
+        assert(parser.Done());
+        assert(parser.KeepAlive() == keepAlive);
+        assert(std::string(parser.GetResponse().content.begin(), parser.GetResponse().content.end()) == body);
+      }
+    }
+  }
+
+  void test_Parser_Callback() {
+    std::string raw = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabc\r\n2\r\nde\r\n0\r\n\r\nHTTP/1.1";
+    std::string body;
+    Parser parser{[&body](const char* data, size_t size) { body.append(data, size); }};
+
+    assert(parser.Feed(raw.data(), raw.size()) == raw.size() - 8);
+    assert(parser.Done());
+    assert(body == "abcde");
+    assert(parser.GetResponse().content.empty());
+  }
+
+  void test_Parser_Observer() {
+    std::string seen;
+    Parser parser{nullptr, false, [&seen](const char* data, size_t size) { seen.append(data, size); }};
+
+    std::string head = "HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\nabc";
+    parser.Feed(head.data(), head.size());
+
+    // bytes received straight into the body window are observed as well
+    auto [window, windowSize] = parser.BodyWindow();
+    assert(windowSize == 7);
+    std::memcpy(window, "defghij", 7);
+    parser.Commit(7);
+
+    assert(parser.Done());
+    assert(seen == "abcdefghij");
+  }
+
+  void test_Parser_Resume() {
+    auto map = {
+        std::make_tuple(std::string("HTTP/1.1 206 Partial Content\r\nContent-Length: 3\r\n\r\ndef"), "def"),
+        std::make_tuple(std::string("HTTP/1.1 200 OK\r\nContent-Length: 6\r\n\r\nabcdef"), "def"),
+        std::make_tuple(std::string("HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n2\r\nab\r\n4\r\ncdef\r\n0\r\n\r\n"), "def")};
+
+    for (const auto& i : map) {
+      auto [raw, body] = i;  // NOLINT(performance-unnecessary-copy-initialization)
+
+      std::string seen;
+      Parser parser{[&seen](const char* data, size_t size) { seen.append(data, size); }};
+      parser.Resume(3);
+      parser.Feed(raw.data(), raw.size());
+      assert(parser.Done());
+      assert(seen == body);
+      assert(parser.Received() == 3);
+    }
+
+    bool thrown = false;
+    Parser parser;
+    parser.Resume(3);
+    std::string unsatisfiable = "HTTP/1.1 416 Range Not Satisfiable\r\n\r\n";
+    try {
+      parser.Feed(unsatisfiable.data(), unsatisfiable.size());
+    } catch (const TransferException&) {
+      thrown = true;
+    }
+    assert(thrown);
+  }
+
+  void test_Parser_Finish() {
+    std::string raw = "HTTP/1.0 200 OK\r\n\r\nuntil close";
+    Parser parser;
+    parser.Feed(raw.data(), raw.size());
+    assert(!parser.Done());
+    parser.Finish();
+    assert(parser.Done());
+    assert(!parser.KeepAlive());
+    assert(parser.GetResponse().size == 11);
+
+    bool thrown = false;
+    Parser truncated;
+    std::string partial = "HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\nabc";
+    truncated.Feed(partial.data(), partial.size());
+    try {
+      truncated.Finish();
+    } catch (const TransferException&) {
+      thrown = true;
+    }
+    assert(thrown);
+  }
+
+#ifndef _WIN32
+  /**
+   * Local stand-in registry serving one body after an optional delay, which
+   * starts with connection delayFrom. Unless dropFirst is unset the first
+   * connection is dropped halfway through the body; Range requests are honoured.
+   */
+  class StandIn {
+  public:
+    explicit StandIn(std::string body, bool dropFirst = true, std::chrono::milliseconds delay = {}, int delayFrom = 0)
+        : _body(std::move(body)), _dropFirst(dropFirst), _delay(delay), _delayFrom(delayFrom) {
+      this->_listener = ::socket(AF_INET, SOCK_STREAM, 0);
+      sockaddr_in address{};
+      address.sin_family      = AF_INET;
+      address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      ::bind(this->_listener, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+      ::listen(this->_listener, 8);
+
+      socklen_t length = sizeof(address);
+      ::getsockname(this->_listener, reinterpret_cast<sockaddr*>(&address), &length);
+      this->port = ntohs(address.sin_port);
+
+      this->_thread = std::thread([this]() { this->Serve(); });
+    }
+
+    ~StandIn() {
+      ::shutdown(this->_listener, SHUT_RDWR);
+      ::close(this->_listener);
+      this->_thread.join();
+    }
+
+    unsigned short port = 0;
+    std::vector<std::string> ranges;
+
+  private:
+    void Serve() {
+      for (int connection = 0;; connection++) {
+        int fd = ::accept(this->_listener, nullptr, nullptr);
+        if (fd < 0) return;
+
+        std::string request;
+        char buffer[1024];
+        while (request.find("\r\n\r\n") == std::string::npos) {
+          auto n = ::recv(fd, buffer, sizeof(buffer), 0);
+          if (n <= 0) break;
+          request.append(buffer, size_t(n));
+        }
+
+        size_t offset = 0;
+        auto range    = request.find("Range: bytes=");
+        if (range != std::string::npos) {
+          offset = std::stoul(request.substr(range + 13));
+          this->ranges.push_back(request.substr(range + 13, request.find('\r', range) - range - 13));
+        }
+
+        if (connection >= this->_delayFrom) std::this_thread::sleep_for(this->_delay);
+        std::string rest = this->_body.substr(offset);
+        std::string response =
+            std::string(offset > 0 ? "HTTP/1.1 206 Partial Content" : "HTTP/1.1 200 OK") +
+            "\r\nContent-Length: " + std::to_string(rest.size()) + "\r\nConnection: close\r\n\r\n" +
+            (connection == 0 && this->_dropFirst ? rest.substr(0, rest.size() / 2) : rest);
+        ::send(fd, response.data(), response.size(), MSG_NOSIGNAL);
+        ::close(fd);
+      }
+    }
+
+    std::string _body;
+    bool _dropFirst;
+    std::chrono::milliseconds _delay;
+    int _delayFrom;
+    int _listener = -1;
+    std::thread _thread;
+  };
+
+  void test_Client_Resume() {
+    std::string body(100000, 'x');
+    for (size_t i = 0; i < body.size(); i++) body[i] = char('a' + i % 26);
+
+    StandIn server(body);
+    Resolver resolver{{{"stand-in", {"127.0.0.1"}}}};
+    Client client("stand-in:" + std::to_string(server.port), resolver);
+    client.Retry(RetryPolicy{.attempts = 3, .backoff = std::chrono::milliseconds(1)});
+
+    std::string seen;
+    auto response = client.Download("/x.tgz", nullptr, [&seen](const char* data, size_t size) { seen.append(data, size); });
+    assert(response.status == 200);
+    assert(std::string(response.content.begin(), response.content.end()) == body);
+    assert(seen == body);
+    assert(server.ranges.size() == 1 && server.ranges[0] == "50000-");
+  }
+
+#  ifdef __linux__
+  void test_EventLoop_Resume() {
+    std::string body(100000, 'y');
+    StandIn server(body);
+    Resolver resolver{{{"stand-in", {"127.0.0.1"}}}};
+    EventLoop loop(4, resolver);
+
+    std::promise<Response> done;
+    loop.Submit(Request{
+        .host    = "stand-in:" + std::to_string(server.port),
+        .path    = "/x.tgz",
+        .retry   = RetryPolicy{.attempts = 3, .backoff = std::chrono::milliseconds(1)},
+        .onDone  = [&done](Response&& response) { done.set_value(std::move(response)); },
+        .onError = [&done](const std::exception& e) { done.set_exception(std::make_exception_ptr(e)); }});
+    loop.Wait();
+
+    auto response = done.get_future().get();
+    assert(std::string(response.content.begin(), response.content.end()) == body);
+    assert(server.ranges.size() == 1 && server.ranges[0] == "50000-");
+  }
+
+  void test_EventLoop_Hedge() {
+    StandIn slow("slow", false, std::chrono::milliseconds(500));
+    StandIn fast("fast", false);
+    Resolver resolver{{{"slow", {"127.0.0.1"}}, {"fast", {"127.0.0.1"}}}};
+    EventLoop loop(4, resolver);
+
+    std::vector<std::string> bodies;
+    loop.Submit(Request{
+        .host       = "slow:" + std::to_string(slow.port),
+        .path       = "/x.tgz",
+        .onReceived = [&bodies](const char* data, size_t size) { bodies.emplace_back(data, size); },
+        .mirrors    = {"fast:" + std::to_string(fast.port)},
+        .hedgeAfter = std::chrono::milliseconds(20),
+        .onDone     = [&bodies](Response&& response) { bodies.emplace_back(response.content.begin(), response.content.end()); }});
+    loop.Wait();
+
+    // the hedged copy won, the slow request was cancelled before delivering anything
+    assert(bodies.size() == 2);
+    assert(bodies[0] == "fast" && bodies[1] == "fast");
+  }
+
+  void test_EventLoop_HedgeResumed() {
+    std::string body(100000, 'z');
+    for (size_t i = 0; i < body.size(); i++) body[i] = char('a' + i % 26);
+
+    // the first attempt is dropped halfway, the resumed one stalls long enough to be hedged
+    StandIn slow(body, true, std::chrono::milliseconds(300), 1);
+    StandIn fast(body, false);
+    Resolver resolver{{{"slow", {"127.0.0.1"}}, {"fast", {"127.0.0.1"}}}};
+    EventLoop loop(4, resolver);
+
+    std::string seen;
+    std::string content;
+    loop.Submit(Request{
+        .host       = "slow:" + std::to_string(slow.port),
+        .path       = "/x.tgz",
+        .onReceived = [&seen](const char* data, size_t size) { seen.append(data, size); },
+        .retry      = RetryPolicy{.attempts = 3, .backoff = std::chrono::milliseconds(1)},
+        .mirrors    = {"fast:" + std::to_string(fast.port)},
+        .hedgeAfter = std::chrono::milliseconds(20),
+        .onDone     = [&content](Response&& response) { content.assign(response.content.begin(), response.content.end()); }});
+    loop.Wait();
+
+    // a copy from byte 0 would feed the kept half to onReceived twice, as an integrity checker sees it
+    assert(content == body);
+    assert(seen == body);
+    assert(slow.ranges.size() == 1 && slow.ranges[0] == "50000-");
+  }
+
+  void test_EventLoop_HedgeOverLimit() {
+    StandIn slow("slow", false, std::chrono::milliseconds(500));
+    StandIn fast("fast", false);
+    Resolver resolver{{{"slow", {"127.0.0.1"}}, {"fast", {"127.0.0.1"}}}};
+    EventLoop loop(2, resolver);
+
+    // more requests than connections: the ones queued behind the limit start once the cancelled losers free their slots
+    std::atomic<int> done{0};
+    for (int i = 0; i < 6; i++) {
+      loop.Submit(Request{
+          .host       = "slow:" + std::to_string(slow.port),
+          .path       = "/x" + std::to_string(i) + ".tgz",
+          .mirrors    = {"fast:" + std::to_string(fast.port)},
+          .hedgeAfter = std::chrono::milliseconds(20),
+          .onDone     = [&done](Response&& response) {
+            assert(std::string(response.content.begin(), response.content.end()) == "fast");
+            done++;
+          }});
+    }
+
+    auto waited = std::async(std::launch::async, [&loop]() { loop.Wait(); });
+    assert(waited.wait_for(std::chrono::seconds(10)) == std::future_status::ready);
+    assert(done == 6);
+  }
+#  endif
+
+#  ifdef NPMCI_TLS
+  /**
+   * Local https stand-in registry with a fresh self-signed certificate for
+   * "stand-in". Every connection answers one request and is closed; handshakes
+   * that resumed an earlier session are counted.
+   */
+  class TlsStandIn {
+  public:
+    explicit TlsStandIn(std::string body)
+        : _body(std::move(body)) {
+      EVP_PKEY* key = nullptr;
+      auto* keyContext = ::EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr);
+      ::EVP_PKEY_keygen_init(keyContext);
+      EVP_PKEY_CTX_set_ec_paramgen_curve_nid(keyContext, NID_X9_62_prime256v1);
+      ::EVP_PKEY_keygen(keyContext, &key);
+      ::EVP_PKEY_CTX_free(keyContext);
+
+      X509* certificate = ::X509_new();
+      ::X509_set_version(certificate, 2);
+      ::ASN1_INTEGER_set(::X509_get_serialNumber(certificate), 1);
+      ::X509_gmtime_adj(X509_getm_notBefore(certificate), -60);
+      ::X509_gmtime_adj(X509_getm_notAfter(certificate), 3600);
+      ::X509_NAME_add_entry_by_txt(::X509_get_subject_name(certificate), "CN", MBSTRING_ASC,
+          reinterpret_cast<const unsigned char*>("stand-in"), -1, -1, 0);
+      ::X509_set_issuer_name(certificate, ::X509_get_subject_name(certificate));
+      ::X509_set_pubkey(certificate, key);
+      X509V3_CTX extensions;
+      X509V3_set_ctx(&extensions, certificate, certificate, nullptr, nullptr, 0);
+      auto* alternative = ::X509V3_EXT_conf_nid(nullptr, &extensions, NID_subject_alt_name, "DNS:stand-in");
+      ::X509_add_ext(certificate, alternative, -1);
+      ::X509_EXTENSION_free(alternative);
+      ::X509_sign(certificate, key, ::EVP_sha256());
+
+      BIO* pem = ::BIO_new(::BIO_s_mem());
+      ::PEM_write_bio_X509(pem, certificate);
+      char* data;
+      long size = BIO_get_mem_data(pem, &data);
+      this->pem.assign(data, size_t(size));
+      ::BIO_free(pem);
+
+      this->_context = ::SSL_CTX_new(::TLS_server_method());
+      ::SSL_CTX_use_certificate(this->_context, certificate);
+      ::SSL_CTX_use_PrivateKey(this->_context, key);
+      ::X509_free(certificate);
+      ::EVP_PKEY_free(key);
+
+      this->_listener = ::socket(AF_INET, SOCK_STREAM, 0);
+      sockaddr_in address{};
+      address.sin_family      = AF_INET;
+      address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      ::bind(this->_listener, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+      ::listen(this->_listener, 8);
+
+      socklen_t length = sizeof(address);
+      ::getsockname(this->_listener, reinterpret_cast<sockaddr*>(&address), &length);
+      this->port = ntohs(address.sin_port);
+
+      this->_thread = std::thread([this]() { this->Serve(); });
+    }
+
+    ~TlsStandIn() {
+      ::shutdown(this->_listener, SHUT_RDWR);
+      ::close(this->_listener);
+      this->_thread.join();
+      ::SSL_CTX_free(this->_context);
+    }
+
+    unsigned short port = 0;
+    std::string pem;
+    std::atomic<int> handshakes{0};
+    std::atomic<int> resumed{0};
+
+  private:
+    void Serve() {
+      while (true) {
+        int fd = ::accept(this->_listener, nullptr, nullptr);
+        if (fd < 0) return;
+
+        SSL* ssl = ::SSL_new(this->_context);
+        ::SSL_set_fd(ssl, fd);
+      if (::SSL_accept(ssl) == 1) {
+          this->handshakes++;
+          if (::SSL_session_reused(ssl)) this->resumed++;
+
+          std::string request;
+          char buffer[1024];
+          while (request.find("\r\n\r\n") == std::string::npos) {
+            int n = ::SSL_read(ssl, buffer, sizeof(buffer));
+            if (n <= 0) break;
+            request.append(buffer, size_t(n));
+          }
+
+          std::string response = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(this->_body.size()) +
+                                 "\r\nConnection: close\r\n\r\n" + this->_body;
+          ::SSL_write(ssl, response.data(), int(response.size()));
+          ::SSL_shutdown(ssl);
+        }
+        ::SSL_free(ssl);
+        ::close(fd);
+      }
+    }
+
+    std::string _body;
+    SSL_CTX* _context = nullptr;
+    int _listener     = -1;
+    std::thread _thread;
+  };
+
+  void test_Client_Tls() {
+    std::string body(100000, 't');
+    TlsStandIn server(body);
+    Resolver resolver{{{"stand-in", {"127.0.0.1"}}}};
+    TlsContext tls;
+    tls.Trust(server.pem);
+
+    // the server closes every connection, the second one resumes the session of the first
+    Client client("https://stand-in:" + std::to_string(server.port), resolver, tls);
+    for (int i = 0; i < 2; i++) {
+      auto response = client.Download("/x.tgz");
+      assert(response.status == 200);
+      assert(std::string(response.content.begin(), response.content.end()) == body);
+    }
+    assert(server.handshakes == 2);
+    assert(server.resumed == 1);
+
+    // certificates are verified against the trust store
+    TlsContext system;
+    Client untrusted("https://stand-in:" + std::to_string(server.port), resolver, system);
+    untrusted.Retry(RetryPolicy{.attempts = 1});
+    bool thrown = false;
+    try {
+      untrusted.Download("/x.tgz");
+    } catch (const ConnectionException&) {
+      thrown = true;
+    }
+    assert(thrown);
+  }
+
+#    ifdef __linux__
+  void test_EventLoop_Tls() {
+    TlsStandIn server("tls");
+    Resolver resolver{{{"stand-in", {"127.0.0.1"}}}};
+    TlsContext tls;
+    tls.Trust(server.pem);
+    EventLoop loop(4, resolver, tls);
+
+    std::vector<std::string> bodies;
+    for (int i = 0; i < 2; i++) {
+      loop.Submit(Request{
+          .host   = "https://stand-in:" + std::to_string(server.port),
+          .path   = "/x.tgz",
+          .onDone = [&bodies](Response&& response) { bodies.emplace_back(response.content.begin(), response.content.end()); }});
+      loop.Wait();
+    }
+
+    assert(bodies.size() == 2 && bodies[0] == "tls" && bodies[1] == "tls");
+    assert(server.handshakes == 2);
+    assert(server.resumed == 1);
+  }
+#    endif
+#  endif
+#endif
+}  // namespace http
+
+auto main() -> int {
+  http::test_parse_headers();
+  http::test_Parser_Framing();
+  http::test_Parser_Callback();
+  http::test_Parser_Observer();
+  http::test_Parser_Resume();
+  http::test_Parser_Finish();
+#ifndef _WIN32
+  http::test_Client_Resume();
+#  ifdef __linux__
+  http::test_EventLoop_Resume();
+  http::test_EventLoop_Hedge();
+  http::test_EventLoop_HedgeResumed();
+  http::test_EventLoop_HedgeOverLimit();
+#  endif
+#  ifdef NPMCI_TLS
+  http::test_Client_Tls();
+#    ifdef __linux__
+  http::test_EventLoop_Tls();
+#    endif
+#  endif
+#endif
+
+  return 0;
+}
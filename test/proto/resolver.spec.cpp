@@ -0,0 +1,62 @@
+#include "../../src/proto/resolver.hpp"
+#include <cassert>
+
+namespace http {
+  void test_Resolver_Seed() {
+    Resolver resolver{{{"registry.local", {"127.0.0.1", "127.0.0.2", "::1"}}}};
+
+    auto addresses = resolver.Resolve("registry.local", 8080);
+    assert(addresses.size() == 3);
+    // families are interleaved for Happy Eyeballs
+    assert(addresses[0].family == AF_INET);
+    assert(addresses[1].family == AF_INET6);
+    assert(addresses[2].family == AF_INET);
+    assert(ntohs(reinterpret_cast<const sockaddr_in*>(addresses[0].Get())->sin_port) == 8080);
+    assert(ntohs(reinterpret_cast<const sockaddr_in6*>(addresses[1].Get())->sin6_port) == 8080);
+
+    // the port is applied per call, the cached entry stays untouched
+    auto other = resolver.Resolve("registry.local", 80);
+    assert(ntohs(reinterpret_cast<const sockaddr_in*>(other[0].Get())->sin_port) == 80);
+  }
+
+  void test_Resolver_Failure() {
+    Resolver resolver;
+    bool thrown = false;
+    try {
+      resolver.Resolve("name.invalid", 80);
+    } catch (const ResolveException&) {
+      thrown = true;
+    }
+    assert(thrown);
+  }
+
+  void test_Resolver_SeedEmpty() {
+    Resolver resolver{{{"name.invalid", {}}}};
+    bool thrown = false;
+    try {
+      resolver.Resolve("name.invalid", 80);  // looked up, not an empty cached entry
+    } catch (const ResolveException&) {
+      thrown = true;
+    }
+    assert(thrown);
+
+    resolver.Seed("name.invalid", {"127.0.0.1"});
+    assert(resolver.Resolve("name.invalid", 80).size() == 1);
+    resolver.Seed("name.invalid", {});
+    thrown = false;
+    try {
+      resolver.Resolve("name.invalid", 80);
+    } catch (const ResolveException&) {
+      thrown = true;
+    }
+    assert(thrown);
+  }
+}  // namespace http
+
+auto main() -> int {
+  http::test_Resolver_Seed();
+  http::test_Resolver_Failure();
+  http::test_Resolver_SeedEmpty();
+
+  return 0;
+}
@@ -0,0 +1,59 @@
+#include "../../src/util/buffer_pool.hpp"
+#include <cassert>
+#include <tuple>
+
+namespace buffers {
+  void test_Pool_Capacity() {
+    auto map = {
+        std::make_tuple(size_t(0), size_t(64 * 1024)),
+        std::make_tuple(size_t(64 * 1024), size_t(64 * 1024)),
+        std::make_tuple(size_t(64 * 1024 + 1), size_t(80 * 1024)),
+        std::make_tuple(size_t(100 * 1024), size_t(112 * 1024)),
+        std::make_tuple(size_t(1000 * 1000), size_t(1024 * 1024)),
+        std::make_tuple(size_t(1100 * 1000), size_t(1280 * 1024))};
+
+    for (const auto& i : map) {
+      auto [size, capacity] = i;
+      assert(Pool::Capacity(size) == capacity);
+    }
+  }
+
+  void test_Pool_Reuse() {
+    Pool pool;
+    unsigned char* first;
+    {
+      auto buffer = pool.Acquire(100 * 1024);
+      assert(buffer.Size() == 100 * 1024 && buffer.Capacity() == 112 * 1024);
+      first = buffer.Data();
+    }
+    assert(pool.IdleBytes() == 112 * 1024);
+
+    auto same = pool.Acquire(110 * 1024);  // same size class
+    assert(same.Data() == first);
+    assert(pool.IdleBytes() == 0);
+
+    auto other = pool.Acquire(10);
+    assert(other.Data() != first);
+
+    auto moved = std::move(same);
+    moved.Release();
+    assert(pool.IdleBytes() == 112 * 1024);
+  }
+
+  void test_Pool_MaxIdle() {
+    Pool pool(100 * 1024);
+    {
+      auto a = pool.Acquire(64 * 1024);
+      auto b = pool.Acquire(64 * 1024);
+    }
+    assert(pool.IdleBytes() == 64 * 1024);
+  }
+}  // namespace buffers
+
+auto main() -> int {
+  buffers::test_Pool_Capacity();
+  buffers::test_Pool_Reuse();
+  buffers::test_Pool_MaxIdle();
+
+  return 0;
+}
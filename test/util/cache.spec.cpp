@@ -0,0 +1,82 @@
+#include "../../src/util/cache.hpp"
+#include <cassert>
+#include <tuple>
+
+namespace cache {
+  void test_base64_to_hex() {
+    auto map = {
+        std::make_tuple("", ""),
+        std::make_tuple("AA==", "00"),
+        std::make_tuple("q+/9", "abeffd"),
+        std::make_tuple("3q2+7w==", "deadbeef"),
+        std::make_tuple("not base64!", "")};
+
+    for (const auto& i : map) {
+      auto [source, result] = i;
+      assert(base64_to_hex(source) == result);
+    }
+  }
+
+  // 0xdeadbeef repeated to the digest size of sha512 and sha1
+  const std::string kSha512 = "sha512-3q2+796tvu/erb7v3q2+796tvu/erb7v3q2+796tvu/erb7v3q2+796tvu/erb7v3q2+796tvu/erb7v3q2+7w==";
+  const std::string kSha1   = "sha1-3q2+796tvu/erb7v3q2+796tvu8=";
+
+  void test_Store_Path() {
+    Store store("root");
+    std::string deadbeef;
+    for (int i = 0; i < 16; ++i) deadbeef += "deadbeef";
+
+    assert(store.Path(kSha512) == "root/sha512/de/" + deadbeef.substr(2));
+    assert(store.Path(kSha512 + " " + kSha1) == "root/sha512/de/" + deadbeef.substr(2));
+    assert(store.Path(kSha512 + "?foo") == "root/sha512/de/" + deadbeef.substr(2));
+    assert(store.Path(kSha1) == "root/sha1/de/" + deadbeef.substr(2, 38));
+    assert(store.Path("").empty());
+    assert(store.Path("3q2+7w==").empty());
+    assert(store.Path("sha512-3q2+7w==").empty());                    // too short for sha512
+    assert(store.Path("sha256-" + kSha512.substr(7)).empty());        // unsupported algorithm
+    assert(store.Path("../../x-" + kSha512.substr(7)).empty());       // not an algorithm at all
+    assert(store.Path("sha1-3q2+796tvu/erb7v3q2+796tv.8=").empty());  // not base64
+    assert(store.Path("sha1-3q2+796tvu/erb7v3q2+796tvu8").empty());   // unpadded
+    assert(store.Path("sha1-3q2+796tvu/erb7v3q2+79=tvu8=").empty());  // padding inside
+  }
+
+  void test_Store_RoundTrip() {
+    Store store("./cache_spec_root");
+    std::vector<char> content{'\x1f', '\x8b', '\0', 'x'};
+    std::vector<char> read;
+
+    assert(!store.Read(kSha512, read));
+    store.Write(kSha512, content);
+    assert(store.Read(kSha512, read));
+    assert(read == content);
+
+    store.Remove(kSha512);
+    assert(!store.Read(kSha512, read));
+  }
+
+  void test_Sizes() {
+    std::string path = "./cache_spec_root/sizes";
+    std::remove(path.c_str());
+
+    Sizes sizes(path);
+    assert(sizes.Get("http://r/a.tgz") == 0);
+    sizes.Record("http://r/a.tgz", 42);
+    sizes.Record("http://r/b.tgz", 7);
+    sizes.Save();
+
+    Sizes loaded(path);
+    assert(loaded.Get("http://r/a.tgz") == 42);
+    assert(loaded.Get("http://r/b.tgz") == 7);
+
+    std::remove(path.c_str());
+  }
+}  // namespace cache
+
+auto main() -> int {
+  cache::test_base64_to_hex();
+  cache::test_Store_Path();
+  cache::test_Store_RoundTrip();
+  cache::test_Sizes();
+
+  return 0;
+}
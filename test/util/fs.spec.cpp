@@ -0,0 +1,68 @@
+#include "../../src/util/fs.hpp"
+#include <cassert>
+#include <thread>
+#include <unistd.h>
+
+namespace fs {
+  auto isDirectory(const std::string& path) -> bool {
+    struct stat info {};
+    return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+  }
+
+  void test_Directories_Create() {
+    Directories directories;
+
+    directories.Create("./fs_spec_root/a/b/file.js", false);
+    assert(isDirectory("./fs_spec_root/a/b"));
+    assert(!isDirectory("./fs_spec_root/a/b/file.js"));
+
+    directories.Create("./fs_spec_root/a/c/", true);
+    assert(isDirectory("./fs_spec_root/a/c"));
+
+    // a known directory removed behind the cache's back is not created again
+    rmdir("./fs_spec_root/a/c");
+    directories.Create("./fs_spec_root/a/c/file.js", false);
+    assert(!isDirectory("./fs_spec_root/a/c"));
+
+    directories.Create("file.js", false);
+    directories.Create("", true);
+
+    rmdir("./fs_spec_root/a/b");
+    rmdir("./fs_spec_root/a");
+    rmdir("./fs_spec_root");
+  }
+
+  void test_Directories_Concurrent() {
+    Directories directories;
+    std::vector<std::thread> workers;
+    for (int worker = 0; worker < 8; worker++) {
+      workers.emplace_back([&directories, worker]() {
+        for (int i = 0; i < 200; i++) {
+          std::string package = "./fs_spec_threads/node_modules/p" + std::to_string((i + worker) % 10);
+          directories.Create(package + "/lib/d" + std::to_string(i % 5) + "/file" + std::to_string(worker) + ".js", false);
+        }
+      });
+    }
+    for (auto& worker : workers) worker.join();
+
+    for (int p = 0; p < 10; p++) {
+      std::string package = "./fs_spec_threads/node_modules/p" + std::to_string(p);
+      for (int d = 0; d < 5; d++) {
+        assert(isDirectory(package + "/lib/d" + std::to_string(d)));
+        rmdir((package + "/lib/d" + std::to_string(d)).c_str());
+      }
+      rmdir((package + "/lib").c_str());
+      rmdir(package.c_str());
+    }
+    rmdir("./fs_spec_threads/node_modules");
+    rmdir("./fs_spec_threads");
+    assert(!isDirectory("./fs_spec_threads"));
+  }
+}  // namespace fs
+
+auto main() -> int {
+  fs::test_Directories_Create();
+  fs::test_Directories_Concurrent();
+
+  return 0;
+}
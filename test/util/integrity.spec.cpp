@@ -0,0 +1,71 @@
+#include "../../src/util/integrity.hpp"
+#include <cassert>
+#include <string>
+#include <tuple>
+
+namespace integrity {
+  auto hex(const Sha512::Digest& digest) -> std::string {
+    static const char* digits = "0123456789abcdef";
+    std::string out;
+    for (auto byte : digest) {
+      out += digits[byte >> 4U];
+      out += digits[byte & 0xFU];
+    }
+    return out;
+  }
+
+  void test_Sha512() {
+    auto map = {
+        std::make_tuple(std::string(""), "cf83e1357eefb8bdf1542850d66d8007d620e4050b5715dc83f4a921d36ce9ce47d0d13c5d85f2b0ff8318d2877eec2f63b931bd47417a81a538327af927da3e"),
+        std::make_tuple(std::string("abc"), "ddaf35a193617abacc417349ae20413112e6fa4e89a97ea20a9eeee64b55d39a2192992a274fc1a836ba3c23a3feebbd454d4423643ce80e2a9ac94fa54ca49f"),
+        std::make_tuple(std::string("abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu"), "8e959b75dae313da8cf4f72814fc143f8f7779c6eb9f7fa17299aeadb6889018501d289e4900f7e4331b99dec4b5433ac7d329eeb6dd26545e96e55b874be909"),
+        std::make_tuple(std::string(1000000, 'a'), "e718483d0ce769644e2e42c7bc15b4638e1f98b13b2044285632a803afa973ebde0ff244877ea60a4cb0432ce577c31beb009c5c2c49aa2e4eadb217ad8cc09b")};
+
+    for (const auto& i : map) {
+      auto [message, digest] = i;  // NOLINT(performance-unnecessary-copy-initialization)
+
+      // every split point of the stream must produce the same digest
+      for (size_t split : {size_t(0), size_t(1), size_t(127), size_t(128), message.size() / 2, message.size()}) {
+        if (split > message.size()) continue;
+        Sha512 hash;
+        hash.Update(message.data(), split);
+        hash.Update(message.data() + split, message.size() - split);
+        assert(hex(hash.Final()) == digest);
+      }
+    }
+  }
+
+  void test_Checker() {
+    std::string body = "abc";
+    std::string abc  = "sha512-3a81oZNherrMQXNJriBBMRLm+k6JqX6iCp7u5ktV05ohkpkqJ0/BqDa6PCOj/uu9RU1EI2Q86A4qmslPpUyknw==";
+
+    Checker matching(abc);
+    matching.Update(body.data(), body.size());
+    matching.Verify();
+
+    Checker alternatives("sha1-qZk+NkcGgWq6PiVxeFDCbJzQ2J0= " + abc);
+    alternatives.Update(body.data(), body.size());
+    alternatives.Verify();
+
+    Checker unsupported("sha1-qZk+NkcGgWq6PiVxeFDCbJzQ2J0=");
+    assert(!unsupported.Enabled());
+    unsupported.Verify();
+
+    bool thrown = false;
+    Checker truncated(abc);
+    truncated.Update(body.data(), 2);
+    try {
+      truncated.Verify();
+    } catch (const IntegrityException&) {
+      thrown = true;
+    }
+    assert(thrown);
+  }
+}  // namespace integrity
+
+auto main() -> int {
+  integrity::test_Sha512();
+  integrity::test_Checker();
+
+  return 0;
+}